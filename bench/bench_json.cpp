@@ -0,0 +1,543 @@
+#include "Common.h"
+#include "Json.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <new>
+#include <random>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// simplyjson_bench [--filter=<substring>] [--sizes=small,medium,large] [--min-time=<seconds>]
+//
+// Prints one JSON object per line and case:
+// {"shape":..., "size":..., "case":..., "bytes":..., "iterations":..., "ns_per_op":...,
+//  "mb_per_s":..., "allocs_per_op":..., "alloc_bytes_per_op":..., "peak_rss_kb":..., "rss_growth_kb":...}
+
+using namespace smpj;
+
+// Keeps GCC from inlining free() into callers that got the pointer from operator new, which
+// -Wmismatched-new-delete reports even though the replacements here are consistent.
+#if defined(__GNUC__) || defined(__clang__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+static size_t g_alloc_count = 0;
+static size_t g_alloc_bytes = 0;
+
+void* operator new(size_t size) {
+	++g_alloc_count;
+	g_alloc_bytes += size;
+	if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	try { return operator new(size); }
+	catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return operator new(size, std::nothrow); }
+// Every delete forwards to the plain one, so each allocation function is paired with its own deallocation function.
+BENCH_NOINLINE void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, size_t) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { operator delete(ptr); }
+
+// std::pmr::new_delete_resource allocates through the aligned overloads.
+void* operator new(size_t size, std::align_val_t align) {
+	++g_alloc_count;
+	g_alloc_bytes += size;
+	size_t alignment = static_cast<size_t>(align);
+#ifdef _WIN32
+	if (void* ptr = _aligned_malloc(size ? size : 1, alignment)) return ptr;
+#else
+	if (void* ptr = std::aligned_alloc(alignment, ((size ? size : 1) + alignment - 1) / alignment * alignment)) return ptr;
+#endif
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t align) { return operator new(size, align); }
+#ifdef _WIN32
+BENCH_NOINLINE void operator delete(void* ptr, std::align_val_t) noexcept { _aligned_free(ptr); }
+#else
+BENCH_NOINLINE void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+#endif
+void operator delete[](void* ptr, std::align_val_t align) noexcept { operator delete(ptr, align); }
+void operator delete(void* ptr, size_t, std::align_val_t align) noexcept { operator delete(ptr, align); }
+void operator delete[](void* ptr, size_t, std::align_val_t align) noexcept { operator delete(ptr, align); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+	try { return operator new(size, align); }
+	catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return operator new(size, align, std::nothrow); }
+void operator delete(void* ptr, std::align_val_t align, const std::nothrow_t&) noexcept { operator delete(ptr, align); }
+void operator delete[](void* ptr, std::align_val_t align, const std::nothrow_t&) noexcept { operator delete(ptr, align); }
+
+namespace {
+
+	// On Linux the kernel's high water mark is reset before every case, so peak_rss_kb is the peak of that case.
+	// It still includes whatever is resident when the case starts (the corpus, the parsed document, heap kept by
+	// malloc), so rss_growth_kb reports how far the case raised it. Elsewhere the peak is the process peak so far.
+	void reset_peak_rss() {
+#ifdef __linux__
+		std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+	}
+
+#ifdef __linux__
+	size_t proc_status_kb(const char* field) {
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		size_t length = std::strlen(field);
+		while (std::getline(status, line)) {
+			if (line.compare(0, length, field) == 0) return std::strtoul(line.c_str() + length, nullptr, 10);
+		}
+		return 0;
+	}
+#endif
+
+	size_t current_rss_kb() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.WorkingSetSize / 1024;
+		return 0;
+#elif defined(__linux__)
+		return proc_status_kb("VmRSS:");
+#else
+		return 0;
+#endif
+	}
+
+	size_t peak_rss_kb() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.PeakWorkingSetSize / 1024;
+		return 0;
+#elif defined(__linux__)
+		return proc_status_kb("VmHWM:");
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+		return usage.ru_maxrss / 1024;
+#else
+		return usage.ru_maxrss;
+#endif
+#endif
+	}
+
+	template<typename T>
+	void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r,m"(value) : "memory");
+#else
+		static volatile const void* sink;
+		sink = &value;
+#endif
+	}
+
+	struct BenchConfig {
+		std::string filter;
+		std::vector<std::string> sizes{ "small", "medium", "large" };
+		double min_time = 0.25;
+	};
+
+	struct BenchResult {
+		size_t iterations = 0;
+		double ns_per_op = 0;
+		double allocs_per_op = 0;
+		double alloc_bytes_per_op = 0;
+		size_t peak_rss_kb = 0;
+		size_t rss_growth_kb = 0;
+	};
+
+	// Runs body until min_time has elapsed; ops_per_call lets a single call count as several operations (lookups).
+	BenchResult run_case(const BenchConfig& config, const std::function<void()>& body, size_t ops_per_call = 1) {
+		using clock = std::chrono::steady_clock;
+		reset_peak_rss();
+		size_t rss_before = current_rss_kb();
+		body();
+
+		BenchResult result;
+		size_t allocs_before = g_alloc_count;
+		size_t bytes_before = g_alloc_bytes;
+		auto start = clock::now();
+		auto deadline = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(config.min_time));
+		clock::time_point now;
+		do {
+			body();
+			++result.iterations;
+			now = clock::now();
+		} while (now < deadline);
+
+		double ops = static_cast<double>(result.iterations * ops_per_call);
+		result.ns_per_op = std::chrono::duration<double, std::nano>(now - start).count() / ops;
+		result.allocs_per_op = (g_alloc_count - allocs_before) / ops;
+		result.alloc_bytes_per_op = (g_alloc_bytes - bytes_before) / ops;
+		result.peak_rss_kb = peak_rss_kb();
+		result.rss_growth_kb = result.peak_rss_kb > rss_before ? result.peak_rss_kb - rss_before : 0;
+		return result;
+	}
+
+	void report(const std::string& shape, const std::string& size, const std::string& name, size_t bytes, const BenchResult& result) {
+		double mb_per_s = bytes ? (bytes / (1024.0 * 1024.0)) / (result.ns_per_op * 1e-9) : 0.0;
+		std::printf("{\"shape\":\"%s\",\"size\":\"%s\",\"case\":\"%s\",\"bytes\":%zu,\"iterations\":%zu,"
+			"\"ns_per_op\":%.1f,\"mb_per_s\":%.2f,\"allocs_per_op\":%.2f,\"alloc_bytes_per_op\":%.1f,\"peak_rss_kb\":%zu,\"rss_growth_kb\":%zu}\n",
+			shape.c_str(), size.c_str(), name.c_str(), bytes, result.iterations,
+			result.ns_per_op, mb_per_s, result.allocs_per_op, result.alloc_bytes_per_op, result.peak_rss_kb, result.rss_growth_kb);
+		std::fflush(stdout);
+	}
+
+	// Synthetic corpus. Every generator appends elements until target_bytes is reached,
+	// so all shapes are comparable by input size.
+
+	size_t target_size(const std::string& size) {
+		if (size == "small") return 1 << 10;
+		if (size == "medium") return 64 << 10;
+		if (size == "large") return 1 << 20;
+		return std::stoul(size);
+	}
+
+	std::string random_word(std::mt19937& rng, size_t min_len, size_t max_len) {
+		static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ";
+		std::uniform_int_distribution<size_t> length(min_len, max_len);
+		std::uniform_int_distribution<size_t> letter(0, sizeof(alphabet) - 2);
+		std::string word(length(rng), ' ');
+		for (char& c : word) c = alphabet[letter(rng)];
+		return word;
+	}
+
+	std::string random_number(std::mt19937& rng) {
+		std::uniform_int_distribution<int> kind(0, 2);
+		std::uniform_int_distribution<long long> integer(-1000000, 1000000);
+		std::uniform_real_distribution<double> real(-1000.0, 1000.0);
+		std::ostringstream out;
+		switch (kind(rng)) {
+		case 0:  out << integer(rng); break;
+		case 1:  out.precision(6); out << std::fixed << real(rng); break;
+		default: out.precision(4); out << std::scientific << real(rng); break;
+		}
+		return out.str();
+	}
+
+	std::string gen_numbers(size_t target_bytes, std::mt19937& rng, size_t& count) {
+		std::string out = "[";
+		while (out.size() < target_bytes) {
+			if (count++) out += ", ";
+			out += random_number(rng);
+		}
+		return out + "]";
+	}
+
+	std::string gen_strings(size_t target_bytes, std::mt19937& rng, size_t& count) {
+		static const char* escapes[] = { "\\n", "\\t", "\\\"", "\\\\", "\\/" };
+		std::uniform_int_distribution<int> escape(0, 9);
+		std::string out = "[";
+		while (out.size() < target_bytes) {
+			if (count++) out += ", ";
+			out += "\"" + random_word(rng, 8, 64);
+			int e = escape(rng);
+			if (e < 5) out += escapes[e] + random_word(rng, 1, 16);
+			out += "\"";
+		}
+		return out + "]";
+	}
+
+	std::string gen_unicode(size_t target_bytes, std::mt19937& rng, size_t& count) {
+		static const char* words[] = { "h\xC3\xA9llo", "w\xC3\xB6rld", "\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82",
+			"\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E", "\xF0\x9F\x98\x80", "ascii", "\\u00e9", "\\ud83d\\ude00" };
+		std::uniform_int_distribution<size_t> word(0, sizeof(words) / sizeof(words[0]) - 1);
+		std::uniform_int_distribution<int> length(2, 12);
+		std::string out = "[";
+		while (out.size() < target_bytes) {
+			if (count++) out += ", ";
+			out += "\"";
+			for (int w = length(rng); w > 0; --w) {
+				out += words[word(rng)];
+				if (w > 1) out += ' ';
+			}
+			out += "\"";
+		}
+		return out + "]";
+	}
+
+	std::string gen_nested(size_t target_bytes, std::mt19937& rng, size_t& count) {
+		const int depth = 64;
+		std::string out = "[";
+		while (out.size() < target_bytes) {
+			if (count++) out += ", ";
+			for (int d = 0; d < depth; ++d) out += (d % 2 == 0) ? "{\"child\": " : "[";
+			out += random_number(rng);
+			for (int d = depth - 1; d >= 0; --d) out += (d % 2 == 0) ? "}" : "]";
+		}
+		return out + "]";
+	}
+
+	std::string gen_wide(size_t target_bytes, std::mt19937& rng, size_t& count) {
+		std::uniform_int_distribution<int> kind(0, 3);
+		std::string out = "{";
+		while (out.size() < target_bytes) {
+			if (count) out += ", ";
+			out += "\"key_" + std::to_string(count++) + "\": ";
+			switch (kind(rng)) {
+			case 0:  out += random_number(rng); break;
+			case 1:  out += "\"" + random_word(rng, 4, 32) + "\""; break;
+			case 2:  out += (count % 2) ? "true" : "false"; break;
+			default: out += "null"; break;
+			}
+		}
+		return out + "}";
+	}
+
+	std::string gen_records(size_t target_bytes, std::mt19937& rng, size_t& count) {
+		std::uniform_int_distribution<int> tags(0, 4);
+		std::string out = "[";
+		while (out.size() < target_bytes) {
+			if (count) out += ",\n";
+			out += "{\"id\": " + std::to_string(count++);
+			out += ", \"name\": \"" + random_word(rng, 6, 24) + "\"";
+			out += ", \"active\": " + std::string(count % 3 ? "true" : "false");
+			out += ", \"score\": " + random_number(rng);
+			out += ", \"tags\": [";
+			for (int t = tags(rng); t > 0; --t) {
+				out += "\"" + random_word(rng, 3, 10) + "\"";
+				if (t > 1) out += ", ";
+			}
+			out += "], \"parent\": null}";
+		}
+		return out + "]";
+	}
+
+	struct Shape {
+		const char* name;
+		bool is_object;
+		std::string(*generate)(size_t, std::mt19937&, size_t&);
+	};
+
+	const Shape shapes[] = {
+		{ "numbers", false, gen_numbers },
+		{ "strings", false, gen_strings },
+		{ "unicode", false, gen_unicode },
+		{ "nested",  false, gen_nested },
+		{ "wide",    true,  gen_wide },
+		{ "records", false, gen_records }
+	};
+
+	// Schema matching the generated corpus, for the shapes that have a natural one.
+	const char* corpus_schema(const std::string& shape) {
+		if (shape == "numbers") return R"({"type": "array", "items": {"type": "number"}})";
+		if (shape == "strings") return R"({"type": "array", "items": {"type": "string", "maxLength": 1024}})";
+		if (shape == "records") return R"({
+			"type": "array",
+			"items": {
+				"type": "object",
+				"required": ["id", "name", "active", "score", "tags", "parent"],
+				"additionalProperties": false,
+				"properties": {
+					"id": {"type": "integer", "minimum": 0},
+					"name": {"type": "string", "minLength": 1},
+					"active": {"type": "boolean"},
+					"score": {"type": "number"},
+					"tags": {"type": "array", "items": {"type": "string"}, "maxItems": 8},
+					"parent": {"type": "null"}
+				}
+			}
+		})";
+		return nullptr;
+	}
+
+	// Native inputs for makeJson, sized to hold the same number of top level elements as the parsed document.
+	std::function<std::shared_ptr<JsonValue>()> make_native_builder(const std::string& shape, const Json& doc, size_t count, std::mt19937& rng) {
+		if (shape == "numbers") {
+			auto list = std::make_shared<std::vector<double>>();
+			for (size_t i = 0; i < count; ++i) list->push_back(doc[i]->getDouble());
+			return [list]() { return makeJson(*list); };
+		}
+		if (shape == "strings" || shape == "unicode") {
+			auto list = std::make_shared<std::vector<std::string>>();
+			for (size_t i = 0; i < count; ++i) list->push_back(doc[i]->getString());
+			return [list]() { return makeJson(*list); };
+		}
+		if (shape == "wide") {
+			auto object = std::make_shared<std::unordered_map<std::string, double>>();
+			for (size_t i = 0; i < count; ++i) object->emplace("key_" + std::to_string(i), static_cast<double>(i));
+			return [object]() { return makeJson(*object); };
+		}
+		if (shape == "records") {
+			auto list = std::make_shared<std::vector<std::unordered_map<std::string, std::string>>>();
+			for (size_t i = 0; i < count; ++i) {
+				list->push_back({ { "id", std::to_string(i) }, { "name", random_word(rng, 6, 24) }, { "active", "true" } });
+			}
+			return [list]() { return makeJson(*list); };
+		}
+		return nullptr;
+	}
+
+	bool wanted(const BenchConfig& config, const std::string& id) {
+		return config.filter.empty() || id.find(config.filter) != std::string::npos;
+	}
+
+	std::vector<std::string> split(const std::string& input, char delimiter) {
+		std::vector<std::string> parts;
+		std::stringstream stream(input);
+		std::string part;
+		while (std::getline(stream, part, delimiter)) if (!part.empty()) parts.push_back(part);
+		return parts;
+	}
+
+	BenchConfig parse_args(int argc, char** argv) {
+		BenchConfig config;
+		for (int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			if (arg.rfind("--filter=", 0) == 0)        config.filter = arg.substr(9);
+			else if (arg.rfind("--sizes=", 0) == 0)   config.sizes = split(arg.substr(8), ',');
+			else if (arg.rfind("--min-time=", 0) == 0) config.min_time = std::stod(arg.substr(11));
+			else {
+				std::fprintf(stderr, "usage: %s [--filter=<substring>] [--sizes=small,medium,large|<bytes>] [--min-time=<seconds>]\n", argv[0]);
+				std::exit(arg == "--help" ? 0 : 1);
+			}
+		}
+		return config;
+	}
+}
+
+int main(int argc, char** argv) {
+	BenchConfig config = parse_args(argc, argv);
+	namespace fs = std::filesystem;
+	fs::path input_path = fs::temp_directory_path() / "simplyjson_bench_input.json";
+	fs::path output_path = fs::temp_directory_path() / "simplyjson_bench_output.json";
+
+	for (const Shape& shape : shapes) {
+		for (const std::string& size : config.sizes) {
+			std::mt19937 rng(42);
+			size_t element_count = 0;
+			const std::string corpus = shape.generate(target_size(size), rng, element_count);
+			auto id = [&](const char* name) { return std::string(shape.name) + "/" + size + "/" + name; };
+			auto bench = [&](const char* name, size_t bytes, const std::function<void()>& body, size_t ops_per_call = 1) {
+				if (!wanted(config, id(name))) return;
+				report(shape.name, size, name, bytes, run_case(config, body, ops_per_call));
+			};
+
+			ParseError error;
+			const Json doc(corpus, &error);
+			if (error.get_id() != JSON_OK) {
+				std::fprintf(stderr, "%s: corpus rejected: %s\n", id("corpus").c_str(), error.info().c_str());
+				return 1;
+			}
+			const std::string dumped = doc.stringDump();
+
+			bench("parse_string", corpus.size(), [&]() { Json parsed(corpus); do_not_optimize(parsed); });
+			bench("parse_cstr", corpus.size(), [&]() { Json parsed(corpus.c_str()); do_not_optimize(parsed); });
+			bench("try_parse", corpus.size(), [&]() { ParseResult parsed = Json::tryParse(corpus); do_not_optimize(parsed); });
+			if (const char* schema_text = corpus_schema(shape.name)) {
+				const Schema schema{ Json(schema_text) };
+				bench("schema_parse", corpus.size(), [&]() { ParseResult parsed = Json::tryParse(corpus, schema); do_not_optimize(parsed); });
+			}
+			if (shape.is_object || std::string(shape.name) == "records") {
+				const Projection projection = shape.is_object ? Projection{ "key_0", "key_7" } : Projection{ "id", "active" };
+				bench("projection", corpus.size(), [&]() { ParseResult parsed = Json::tryParse(corpus, projection); do_not_optimize(parsed); });
+			}
+			Parser parser;
+			bench("parser_reuse", corpus.size(), [&]() { ParseResult parsed = parser.parse(corpus); do_not_optimize(parsed); });
+			Parser pooled_parser(ParseLimits(), nullptr);
+			bench("parser_pooled", corpus.size(), [&]() { ParseResult parsed = pooled_parser.parse(corpus); do_not_optimize(parsed); });
+			PushParser push_parser;
+			auto push_parse = [&](size_t chunk) {
+				for (size_t pos = 0; pos < corpus.size(); pos += chunk) push_parser.feed(corpus.data() + pos, std::min(chunk, corpus.size() - pos));
+				ParseResult parsed = push_parser.finish();
+				do_not_optimize(parsed);
+			};
+			bench("push_parse_4k", corpus.size(), [&]() { push_parse(size_t(4) << 10); });
+			bench("push_parse_64k", corpus.size(), [&]() { push_parse(size_t(64) << 10); });
+
+			if (wanted(config, id("parse_fstream"))) {
+				std::ofstream(input_path, std::ios::binary).write(corpus.data(), corpus.size());
+				bench("parse_fstream", corpus.size(), [&]() {
+					std::fstream stream;
+					Json parsed(stream, input_path.string());
+					do_not_optimize(parsed);
+				});
+			}
+
+			bench("dump", dumped.size(), [&]() { std::string out = doc.stringDump(); do_not_optimize(out); });
+			bench("write_file", dumped.size(), [&]() {
+				std::fstream stream;
+				doc.writeToFile(stream, output_path.string());
+			});
+			bench("save_file", dumped.size(), [&]() { WriteResult saved = doc.saveToFile(output_path.string()); do_not_optimize(saved); });
+			bench("copy", corpus.size(), [&]() { Json copied(doc); do_not_optimize(copied); });
+
+			bench("freeze", corpus.size(), [&]() { auto frozen = doc.freeze(); do_not_optimize(frozen); });
+			const std::shared_ptr<const FrozenJson> frozen = doc.freeze();
+
+			if (shape.is_object) {
+				std::vector<std::string> keys;
+				for (size_t i = 0; i < element_count; ++i) keys.push_back("key_" + std::to_string(i));
+				bench("lookup", 0, [&]() {
+					for (const auto& key : keys) do_not_optimize(doc[key]);
+				}, keys.size());
+				bench("frozen_lookup", 0, [&]() {
+					for (const auto& key : keys) do_not_optimize((*frozen)[key]);
+				}, keys.size());
+			}
+			else {
+				bench("lookup", 0, [&]() {
+					for (size_t i = 0; i < element_count; ++i) do_not_optimize(doc[i]);
+				}, element_count);
+				bench("frozen_lookup", 0, [&]() {
+					for (size_t i = 0; i < element_count; ++i) do_not_optimize((*frozen)[i]);
+				}, element_count);
+			}
+
+			if (auto builder = make_native_builder(shape.name, doc, element_count, rng)) {
+				bench("make_json", 0, [&]() { auto value = builder(); do_not_optimize(value); });
+			}
+
+			// A small response document, built per record.
+			if (std::string(shape.name) == "records") {
+				bench("build_index", 0, [&]() {
+					Json response;
+					response["id"] = makeJson(42);
+					response["name"] = makeJson(std::string("response name"));
+					response["active"] = makeJson(true);
+					std::vector<std::shared_ptr<JsonValue>> values;
+					for (int i = 0; i < 8; ++i) values.push_back(makeJson(i));
+					response["values"] = makeJson(values);
+					do_not_optimize(response);
+				});
+				bench("build_emplace", 0, [&]() {
+					Json response;
+					response.reserve(4);
+					response.emplace("id", 42);
+					response.emplace("name", std::string("response name"));
+					response.emplace("active", true);
+					auto values = makeNode<JsonList>(response.memoryResource());
+					values->reserve(8);
+					for (int i = 0; i < 8; ++i) values->emplace_back(i);
+					response.emplace("values", std::move(values));
+					do_not_optimize(response);
+				});
+			}
+		}
+	}
+
+	std::error_code ignored;
+	fs::remove(input_path, ignored);
+	fs::remove(output_path, ignored);
+	return 0;
+}
@@ -1,8 +1,19 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
+#include <memory_resource>
 #include <fstream>
 #include <iostream>
 #include <unordered_map>
+#include <map>
+#include <cmath>
 #include <stack>
-#include <memory>
\ No newline at end of file
+#include <memory>
+#include <functional>
+#include <future>
+#include <cstdint>
+#include <stdexcept>
+#include <typeinfo>
+#include <variant>
+#include <atomic>
\ No newline at end of file
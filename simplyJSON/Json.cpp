@@ -1,9 +1,34 @@
 #pragma once
 #include "Json.h"
+#include "StringScan.h"
+#include <chrono>
+#include <charconv>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef SMPJ_ENABLE_STATS
+#define SMPJ_STATS(...) __VA_ARGS__
+#else
+#define SMPJ_STATS(...)
+#endif
 
 using namespace smpj;
 
-bool is_json_number(const std::string& input) 
+bool is_json_number(std::string_view input) 
 {
 	if (input.empty()) return false;
 	size_t i = 0;
@@ -46,37 +71,107 @@ bool isLiteralValid(const std::string& val) {
 	return is_json_number(val);
 }
 
-bool validateObject(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr);
-bool validateList(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr);
-bool validateValue(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr);
+// Map keys are pmr strings and C++17 has no heterogeneous lookup, so lookups copy the key into a
+// per-thread scratch string that keeps its capacity instead of allocating on the document's resource.
+// The scratch outlives any resource installed as the default, so it is bound to new_delete_resource.
+const JsonStringData& lookup_key(const std::string& key) {
+	static thread_local JsonStringData scratch(std::pmr::new_delete_resource());
+	scratch.assign(key.data(), key.size());
+	return scratch;
+}
+
+bool validateObject(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr, size_t depth);
+bool validateList(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr, size_t depth);
+bool validateValue(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr, size_t depth = 0);
 
-std::string parse_json_string(const std::string& input, size_t& it) 
+// Decodes the string whose opening quote is at input[it] into out, leaving it on the closing quote.
+// Plain runs, including validated multi-byte UTF-8, are copied in bulk; only escapes are handled per byte.
+// Returns nullptr on success or a description of the first error.
+const char* decode_json_string(std::string_view input, size_t& it, std::string& out)
+{
+	const char* data = input.data();
+	const size_t size = input.size();
+	out.clear();
+	size_t run_start = ++it;
+	while (it < size) {
+		it = find_string_special(data, it, size);
+		if (it == size) break;
+		unsigned char current = static_cast<unsigned char>(data[it]);
+		if (current >= 0x80) {
+			it = skip_utf8_run(data, it, size);
+			if (it < size && static_cast<unsigned char>(data[it]) >= 0x80) return "Invalid UTF-8 sequence in string";
+			continue;
+		}
+		out.append(data + run_start, it - run_start);
+		if (current == '"') return nullptr;
+		if (current != '\\') return "Unescaped control character in string";
+		if (++it >= size) return "Escape sequence at the end of the string";
+		char escaped = data[it++];
+		switch (escaped) {
+		case '"':	out += '"'; break;
+		case '\\':	out += '\\'; break;
+		case '/':	out += '/'; break;
+		case 'b':	out += '\b'; break;
+		case 'f':	out += '\f'; break;
+		case 'n':	out += '\n'; break;
+		case 'r':	out += '\r'; break;
+		case 't':	out += '\t'; break;
+		case 'u': {
+			uint32_t code_point = 0;
+			const char* error = nullptr;
+			size_t consumed = decode_unicode_escape(data + it, size - it, code_point, error);
+			if (consumed == 0) return error;
+			append_utf8(out, code_point);
+			it += consumed;
+			break;
+		}
+		default:	return "Invalid escape";
+		}
+		run_start = it;
+	}
+	return "Unterminated string";
+}
+
+// decode_json_string without the output: checks escapes and UTF-8 and leaves it on the closing quote.
+const char* validate_json_string(std::string_view input, size_t& it)
 {
+	const char* data = input.data();
+	const size_t size = input.size();
 	++it;
-	std::string working_buffer;
-	while (it < input.size()) {
-		if (input[it] == '"') return working_buffer;
-		char current = input[it++];
-		if (current == '\n' || current == '\r') throw std::runtime_error("\\n and \\r are not allowed in string");
-		if (current == '\\') {
-			if (it >= input.size()) throw std::runtime_error("Escape sequence at the end of the string");
-			char escaped = input[it++];
-			switch (escaped) {
-			case '"':	working_buffer += '"'; break;
-			case '\\':	working_buffer += '\\'; break;
-			case '/':	working_buffer += '/'; break;
-			case 'b':	working_buffer += '\b'; break;
-			case 'f':	working_buffer += '\f'; break;
-			case 'n':	working_buffer += '\n'; break;
-			case 'r':	working_buffer += '\r'; break;
-			case 't':	working_buffer += '\t'; break;
-			case 'u':	throw std::runtime_error("Unicode escaped symbol is not supported");
-			default:	throw std::runtime_error(std::string("Invalid escape \\") + escaped);
-			}
+	while (it < size) {
+		it = find_string_special(data, it, size);
+		if (it == size) break;
+		unsigned char current = static_cast<unsigned char>(data[it]);
+		if (current >= 0x80) {
+			it = skip_utf8_run(data, it, size);
+			if (it < size && static_cast<unsigned char>(data[it]) >= 0x80) return "Invalid UTF-8 sequence in string";
+			continue;
+		}
+		if (current == '"') return nullptr;
+		if (current != '\\') return "Unescaped control character in string";
+		if (++it >= size) return "Escape sequence at the end of the string";
+		switch (data[it++]) {
+		case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+			break;
+		case 'u': {
+			uint32_t code_point = 0;
+			const char* error = nullptr;
+			size_t consumed = decode_unicode_escape(data + it, size - it, code_point, error);
+			if (consumed == 0) return error;
+			it += consumed;
+			break;
+		}
+		default:	return "Invalid escape";
 		}
-		else working_buffer += current;
 	}
-	throw std::runtime_error("Unterminated string");
+	return "Unterminated string";
+}
+
+std::string parse_json_string(const std::string& input, size_t& it) 
+{
+	std::string working_buffer;
+	if (const char* error = decode_json_string(input, it, working_buffer)) throw std::runtime_error(error);
+	return working_buffer;
 }
 
 std::string parse_json_string(std::fstream& file_stream) 
@@ -85,7 +180,7 @@ std::string parse_json_string(std::fstream& file_stream)
 	int current;
 	while ((current = file_stream.get()) != '"') {
 		if(current == EOF) throw std::runtime_error("Unterminated string");
-		if (current == '\n' || current == '\r') throw std::runtime_error("\\n and \\r are not allowed in string");
+		if (current < 0x20) throw std::runtime_error("Unescaped control character in string");
 		if (current == '\\') {
 			int escaped = file_stream.get();
 			if (escaped == EOF) throw std::runtime_error("Escape sequence at the end of the stream");
@@ -98,88 +193,276 @@ std::string parse_json_string(std::fstream& file_stream)
 			case 'n':	working_buffer += '\n'; break;
 			case 'r':	working_buffer += '\r'; break;
 			case 't':	working_buffer += '\t'; break;
-			case 'u':	throw std::runtime_error("Unicode escaped symbol is not supported");
-			default:	throw std::runtime_error(std::string("Invalid escape \\" + static_cast<char>(escaped)));
+			case 'u': {
+				char hex[10];
+				size_t available = static_cast<size_t>(file_stream.read(hex, 4).gcount());
+				if (available == 4 && parse_hex4(hex) >= 0xD800 && parse_hex4(hex) <= 0xDBFF)
+					available += static_cast<size_t>(file_stream.read(hex + 4, 6).gcount());
+				uint32_t code_point = 0;
+				const char* error = nullptr;
+				if (decode_unicode_escape(hex, available, code_point, error) == 0) throw std::runtime_error(error);
+				append_utf8(working_buffer, code_point);
+				break;
+			}
+			default:	throw std::runtime_error(std::string("Invalid escape \\") + static_cast<char>(escaped));
+			}
+		}
+		else if (current >= 0x80) {
+			unsigned char sequence[4] = { static_cast<unsigned char>(current), 0, 0, 0 };
+			size_t length = utf8_expected_length(sequence[0]);
+			for (size_t i = 1; i < length; ++i) {
+				int next = file_stream.get();
+				if (next == EOF) break;
+				sequence[i] = static_cast<unsigned char>(next);
 			}
+			if (length == 0 || utf8_sequence_length(sequence, length) != length) throw std::runtime_error("Invalid UTF-8 sequence in string");
+			working_buffer.append(reinterpret_cast<const char*>(sequence), length);
 		}
 		else working_buffer += static_cast<char>(current);
 	}
 	return working_buffer;
 }
 
-Json::Json(std::fstream& filestream, const std::string& path, ParseError* ex_ptr)
+#ifdef SMPJ_ENABLE_STATS
+// Swapped atomically, so setStatsCallback can run while other threads invoke the previous callback.
+static std::shared_ptr<const JsonStatsCallback> stats_callback;
+static std::atomic<JsonStatsDetail> stats_detail{ STATS_TIMING };
+static thread_local JsonStats last_stats;
+
+template<typename String>
+size_t heap_bytes(const String& str) {
+	const char* object = reinterpret_cast<const char*>(&str);
+	bool is_inline = str.data() >= object && str.data() < object + sizeof(str);
+	return is_inline ? 0 : str.capacity() + 1;
+}
+
+void collect_node_stats(const JsonValue& value, JsonStats& stats, size_t depth) {
+	const size_t control_block = 2 * sizeof(void*);
+	if (depth > stats.max_depth) stats.max_depth = depth;
+	stats.node_count[value.type()]++;
+
+	switch (value.type()) {
+	case JSON_STRING: {
+		const JsonStringData& str = *value.getStringPtr();
+		if (str.size() > stats.largest_string) stats.largest_string = str.size();
+		stats.estimated_bytes += control_block + sizeof(JsonString) + heap_bytes(str);
+		break;
+	}
+	case JSON_VECTOR: {
+		if (const JsonNumberData* numbers = value.getNumbers()) {
+			if (numbers->size() > stats.largest_list) stats.largest_list = numbers->size();
+			if (!numbers->empty() && depth + 1 > stats.max_depth) stats.max_depth = depth + 1;
+			stats.node_count[JSON_DOUBLE] += numbers->size();
+			stats.estimated_bytes += control_block + sizeof(JsonList) + numbers->capacity() * sizeof(double);
+			break;
+		}
+		if (const JsonBoolData* bools = value.getBools()) {
+			if (bools->size() > stats.largest_list) stats.largest_list = bools->size();
+			if (!bools->empty() && depth + 1 > stats.max_depth) stats.max_depth = depth + 1;
+			stats.node_count[JSON_BOOL] += bools->size();
+			stats.estimated_bytes += control_block + sizeof(JsonList) + bools->capacity();
+			break;
+		}
+		const auto& list = value.getList();
+		if (list.size() > stats.largest_list) stats.largest_list = list.size();
+		stats.estimated_bytes += control_block + sizeof(JsonList) + list.capacity() * sizeof(list[0]);
+		for (auto& element : list) collect_node_stats(*element, stats, depth + 1);
+		break;
+	}
+	case JSON_MAP: {
+		const auto& map = *value.getMapPtr();
+		if (map.size() > stats.largest_map) stats.largest_map = map.size();
+		stats.estimated_bytes += control_block + sizeof(JsonMap) + map.bucket_count() * sizeof(void*);
+		for (auto& [key, element] : map) {
+			stats.estimated_bytes += sizeof(*map.begin()) + 2 * sizeof(void*) + heap_bytes(key);
+			collect_node_stats(*element, stats, depth + 1);
+		}
+		break;
+	}
+	case JSON_DOUBLE: stats.estimated_bytes += control_block + sizeof(JsonDouble); break;
+	case JSON_BOOL:   stats.estimated_bytes += control_block + sizeof(JsonBool); break;
+	case JSON_NULL:   stats.estimated_bytes += control_block + sizeof(JsonNull); break;
+	}
+}
+
+// Collects one JsonStats record and publishes it to lastStats() and the callback when the scope ends.
+// Only a parse passes its root, and the root is walked only with STATS_SHAPE.
+class StatsScope {
+	using clock = std::chrono::steady_clock;
+public:
+	JsonStats stats;
+
+	explicit StatsScope(JsonOperation operation, const std::shared_ptr<JsonValue>* root = nullptr,
+		const std::vector<JsonToken>* tokens = nullptr, const ParseError* error = nullptr)
+		: root(root), tokens(tokens), error(error) {
+		stats.operation = operation;
+	}
+	~StatsScope() {
+		bool shape = root != nullptr && stats_detail.load(std::memory_order_relaxed) == STATS_SHAPE;
+		if (tokens != nullptr) {
+			stats.token_count = tokens->size();
+			stats.estimated_bytes += tokens->capacity() * sizeof(JsonToken);
+			if (shape) for (auto& token : *tokens) stats.estimated_bytes += heap_bytes(token.value);
+		}
+		if (error != nullptr) stats.result = error->get_id();
+		if (shape && *root) collect_node_stats(**root, stats, 1);
+		last_stats = stats;
+		std::shared_ptr<const JsonStatsCallback> callback = std::atomic_load(&stats_callback);
+		if (callback) (*callback)(stats);
+	}
+	void begin() { phase_start = clock::now(); }
+	void end(JsonPhase phase) {
+		stats.phase_ns[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - phase_start).count();
+	}
+private:
+	const std::shared_ptr<JsonValue>* root;
+	const std::vector<JsonToken>* tokens;
+	const ParseError* error;
+	clock::time_point phase_start;
+};
+#endif
+
+void Json::setStatsCallback([[maybe_unused]] JsonStatsCallback callback) {
+	SMPJ_STATS(std::atomic_store(&stats_callback, callback ? std::make_shared<const JsonStatsCallback>(std::move(callback)) : nullptr));
+}
+
+void Json::setStatsDetail([[maybe_unused]] JsonStatsDetail detail) {
+	SMPJ_STATS(stats_detail.store(detail, std::memory_order_relaxed));
+}
+
+const JsonStats& Json::lastStats() {
+#ifdef SMPJ_ENABLE_STATS
+	return last_stats;
+#else
+	static const JsonStats empty;
+	return empty;
+#endif
+}
+
+Json::Json(std::fstream& filestream, const std::string& path, ParseError* ex_ptr, std::pmr::memory_resource* resource)
+	: resource(resource)
 {
 	ParseError inner_ex;
 	size_t file_end;
 	std::string file_content;
 	std::vector<JsonToken> tokens;
+	SMPJ_STATS(StatsScope stats_scope(OP_PARSE, &root, &tokens, &inner_ex));
 
 	filestream.open(path, std::ios::in | std::ios::binary | std::ios::ate);
 	if (!filestream.is_open()) throw std::runtime_error("could not open filestream at " + path + "\n");
+	SMPJ_STATS(stats_scope.stats.input_bytes = static_cast<size_t>(filestream.tellg()));
+	SMPJ_STATS(stats_scope.begin());
 	tokens = streaming_tokenize(filestream, &inner_ex);
+	SMPJ_STATS(stats_scope.end(PHASE_TOKENIZE));
 	filestream.close();
-	if (inner_ex.get_id() != JSON_NULL_EX && ex_ptr != nullptr) { *ex_ptr = inner_ex; return; }
+	if (inner_ex.get_id() != JSON_NULL_EX) {
+		if (ex_ptr == nullptr) throw std::runtime_error(inner_ex.info());
+		*ex_ptr = inner_ex;
+		parse_failed = true;
+		return;
+	}
 
+	SMPJ_STATS(stats_scope.begin());
 	bool is_valid = validate(tokens, &inner_ex);
-	if (ex_ptr != nullptr) { 
-		*ex_ptr = inner_ex; 
-		if(!is_valid) return; 
+	SMPJ_STATS(stats_scope.end(PHASE_VALIDATE));
+	if (ex_ptr != nullptr) *ex_ptr = inner_ex;
+	if (!is_valid) {
+		if (ex_ptr == nullptr) throw std::runtime_error(inner_ex.info());
+		parse_failed = true;
+		return;
 	}
 
-	if (tokens[0].type == CBRACKETS_OPEN)	   root = std::make_shared<JsonMap>();
-	else if (tokens[0].type == SBRACKETS_OPEN) root = std::make_shared<JsonList>();
+	SMPJ_STATS(stats_scope.begin());
+	if (tokens[0].type == CBRACKETS_OPEN)	   root = makeNode<JsonMap>(resource);
+	else if (tokens[0].type == SBRACKETS_OPEN) root = makeNode<JsonList>(resource);
 	parse(tokens);
+	SMPJ_STATS(stats_scope.end(PHASE_PARSE));
 }
 
-Json::Json(const std::string& json_string, ParseError* ex_ptr)
+Json::Json(const std::string& json_string, ParseError* ex_ptr, std::pmr::memory_resource* resource)
+	: resource(resource)
 {
 	std::vector<JsonToken> tokens;
 	ParseError inner_ex;
+	SMPJ_STATS(StatsScope stats_scope(OP_PARSE, &root, &tokens, &inner_ex));
+	SMPJ_STATS(stats_scope.stats.input_bytes = json_string.size());
 
+	SMPJ_STATS(stats_scope.begin());
 	tokens = tokenize(json_string, &inner_ex);
-	if (inner_ex.get_id() != JSON_NULL_EX && ex_ptr != nullptr) { *ex_ptr = inner_ex; return; }
-	bool is_valid = validate(tokens, &inner_ex);
-	if (ex_ptr != nullptr) {
+	SMPJ_STATS(stats_scope.end(PHASE_TOKENIZE));
+	if (inner_ex.get_id() != JSON_NULL_EX) {
+		if (ex_ptr == nullptr) throw std::runtime_error(inner_ex.info());
 		*ex_ptr = inner_ex;
-		if (!is_valid) return;
+		parse_failed = true;
+		return;
+	}
+	SMPJ_STATS(stats_scope.begin());
+	bool is_valid = validate(tokens, &inner_ex);
+	SMPJ_STATS(stats_scope.end(PHASE_VALIDATE));
+	if (ex_ptr != nullptr) *ex_ptr = inner_ex;
+	if (!is_valid) {
+		if (ex_ptr == nullptr) throw std::runtime_error(inner_ex.info());
+		parse_failed = true;
+		return;
 	}
-	if (tokens[0].type == CBRACKETS_OPEN)	   root = std::make_shared<JsonMap>();
-	else if (tokens[0].type == SBRACKETS_OPEN) root = std::make_shared<JsonList>();
+	SMPJ_STATS(stats_scope.begin());
+	if (tokens[0].type == CBRACKETS_OPEN)	   root = makeNode<JsonMap>(resource);
+	else if (tokens[0].type == SBRACKETS_OPEN) root = makeNode<JsonList>(resource);
 	parse(tokens);
+	SMPJ_STATS(stats_scope.end(PHASE_PARSE));
 }
 
-Json::Json(const char* string_literal, ParseError* ex_ptr)
+Json::Json(const char* string_literal, ParseError* ex_ptr, std::pmr::memory_resource* resource)
+	: resource(resource)
 {
 	std::vector<JsonToken> tokens;
 	ParseError inner_ex;
+	SMPJ_STATS(StatsScope stats_scope(OP_PARSE, &root, &tokens, &inner_ex));
+	SMPJ_STATS(stats_scope.stats.input_bytes = std::char_traits<char>::length(string_literal));
 
+	SMPJ_STATS(stats_scope.begin());
 	tokens = tokenize(std::string(string_literal), &inner_ex);
-	if (inner_ex.get_id() != JSON_NULL_EX && ex_ptr != nullptr) { *ex_ptr = inner_ex; return; }
-	bool is_valid = validate(tokens, &inner_ex);
-	if (ex_ptr != nullptr) {
+	SMPJ_STATS(stats_scope.end(PHASE_TOKENIZE));
+	if (inner_ex.get_id() != JSON_NULL_EX) {
+		if (ex_ptr == nullptr) throw std::runtime_error(inner_ex.info());
 		*ex_ptr = inner_ex;
-		if (!is_valid) return;
+		parse_failed = true;
+		return;
+	}
+	SMPJ_STATS(stats_scope.begin());
+	bool is_valid = validate(tokens, &inner_ex);
+	SMPJ_STATS(stats_scope.end(PHASE_VALIDATE));
+	if (ex_ptr != nullptr) *ex_ptr = inner_ex;
+	if (!is_valid) {
+		if (ex_ptr == nullptr) throw std::runtime_error(inner_ex.info());
+		parse_failed = true;
+		return;
 	}
-	if (tokens[0].type == CBRACKETS_OPEN)	   root = std::make_shared<JsonMap>();
-	else if (tokens[0].type == SBRACKETS_OPEN) root = std::make_shared<JsonList>();
+	SMPJ_STATS(stats_scope.begin());
+	if (tokens[0].type == CBRACKETS_OPEN)	   root = makeNode<JsonMap>(resource);
+	else if (tokens[0].type == SBRACKETS_OPEN) root = makeNode<JsonList>(resource);
 	parse(tokens);
+	SMPJ_STATS(stats_scope.end(PHASE_PARSE));
 }
 
-Json::Json(const Json& other) {
-	if(other.root->type() == JSON_MAP)
-		root = std::dynamic_pointer_cast<JsonMap>(other.root->clone());
-	else 
-		root = std::dynamic_pointer_cast<JsonList>(other.root->clone());
-}
+Json::Json(const Json& other)
+	: Json(other, other.resource) {}
+
+Json::Json(const Json& other, std::pmr::memory_resource* resource)
+	: resource(resource), root(other.document()->clone(resource)) {}
 
 Json::Json(Json&& other) noexcept
-	: root(std::move(other.root))
-{
-	other.root = std::make_shared<JsonMap>();
+	: resource(other.resource), root(std::move(other.root)), parse_failed(std::exchange(other.parse_failed, false)) {}
+
+Json& Json::operator=(Json&& other) noexcept {
+	resource = other.resource;
+	root = std::move(other.root);
+	parse_failed = std::exchange(other.parse_failed, false);
+	return *this;
 }
 
-Json::Json()
-	: root(std::make_shared<JsonMap>()){}
+Json::Json(std::pmr::memory_resource* resource)
+	: resource(resource), root(makeNode<JsonMap>(resource)) {}
 
 std::vector<JsonToken> Json::tokenize(const std::string& json_string, ParseError* ex_ptr)
 {
@@ -215,6 +498,7 @@ std::vector<JsonToken> Json::tokenize(const std::string& json_string, ParseError
 			}
 			catch (std::exception& e) {
 				if (ex_ptr) *ex_ptr = ParseError(JSON_INVALID_STRING, e.what(), line, column);
+				return tokens;
 			}
 			tokens.push_back({ QUOTATION, "", line, column++ });
 			break;
@@ -277,6 +561,7 @@ std::vector<JsonToken> Json::streaming_tokenize(std::fstream& file_stream, Parse
 			}
 			catch (std::exception& e) {
 				if (ex_ptr) *ex_ptr = ParseError(JSON_INVALID_STRING, e.what(), line, column);
+				return tokens;
 			}
 			tokens.push_back({ QUOTATION, "", line, column++ });
 			break;
@@ -308,7 +593,7 @@ std::vector<JsonToken> Json::streaming_tokenize(std::fstream& file_stream, Parse
 	return tokens;
 }
 
-bool validateObject(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr) {
+bool validateObject(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr, size_t depth) {
 	if (i < _tokens.size() && _tokens[i].type == CBRACKETS_CLOSE) {
 		++i;
 		return true;
@@ -326,12 +611,12 @@ bool validateObject(const std::vector<JsonToken>& _tokens, size_t& i, ParseError
 		i += 3;
 
 		if (i >= _tokens.size() || _tokens[i].type != COLON) {
-			if (ex_ptr != nullptr) *ex_ptr = ParseError(JSON_MISSING_SYMBOL, "Expected ':' after key", _tokens[i].line, _tokens[i].column - 1);
+			if (ex_ptr != nullptr) *ex_ptr = ParseError(JSON_MISSING_SYMBOL, "Expected ':' after key", _tokens[i - 1].line, _tokens[i - 1].column - 1);
 			return false;
 		}
 		++i;
 
-		if (!validateValue(_tokens, i, ex_ptr)) return false;
+		if (!validateValue(_tokens, i, ex_ptr, depth)) return false;
 
 		if (i < _tokens.size() && _tokens[i].type == COMMA) {
 			++i;
@@ -350,14 +635,14 @@ bool validateObject(const std::vector<JsonToken>& _tokens, size_t& i, ParseError
 	if (ex_ptr != nullptr) *ex_ptr = ParseError(JSON_MISSING_SYMBOL, "Missing closing '}' for object", _tokens.back().line, _tokens.back().column - 1);
 	return false;
 }
-bool validateList(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr) {
+bool validateList(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr, size_t depth) {
 	if (i < _tokens.size() && _tokens[i].type == SBRACKETS_CLOSE) {
 		++i;
 		return true;
 	}
 
 	while (i < _tokens.size()) {
-		if (!validateValue(_tokens, i, ex_ptr)) return false;
+		if (!validateValue(_tokens, i, ex_ptr, depth)) return false;
 
 		if (i < _tokens.size() && _tokens[i].type == COMMA) {
 			++i;
@@ -372,8 +657,11 @@ bool validateList(const std::vector<JsonToken>& _tokens, size_t& i, ParseError*
 			return false;
 		}
 	}
+
+	if (ex_ptr != nullptr) *ex_ptr = ParseError(JSON_MISSING_SYMBOL, "Missing closing ']' for list", _tokens.back().line, _tokens.back().column - 1);
+	return false;
 }
-bool validateValue(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr) {
+bool validateValue(const std::vector<JsonToken>& _tokens, size_t& i, ParseError* ex_ptr, size_t depth) {
 	if (i >= _tokens.size()) {
 		if (ex_ptr != nullptr) *ex_ptr = ParseError(JSON_MISSING_VALUE, "Value is not found", _tokens.back().line, _tokens.back().column - 1);
 		return false;
@@ -400,11 +688,14 @@ bool validateValue(const std::vector<JsonToken>& _tokens, size_t& i, ParseError*
 		i += 3;
 		return true;
 	case CBRACKETS_OPEN:
-		++i;
-		return validateObject(_tokens, i, ex_ptr);
 	case SBRACKETS_OPEN:
+		if (depth >= ParseLimits().max_depth) {
+			if (ex_ptr != nullptr) *ex_ptr = ParseError(JSON_LIMIT_EXCEEDED, "Maximum nesting depth exceeded", token.line, token.column - 1);
+			return false;
+		}
 		++i;
-		return validateList(_tokens, i, ex_ptr);
+		if (token.type == CBRACKETS_OPEN) return validateObject(_tokens, i, ex_ptr, depth + 1);
+		return validateList(_tokens, i, ex_ptr, depth + 1);
 	default:
 		if (ex_ptr != nullptr) *ex_ptr = ParseError(JSON_UNEXPECTED_SYMBOL, "Unexpected token where expecting value", token.line, token.column - 1);
 		return false;
@@ -428,11 +719,12 @@ bool Json::validate(const std::vector<JsonToken>& tokens, ParseError* ex_ptr) {
 
 	if (ok && ex_ptr)
 		*ex_ptr = ParseError(JSON_OK, "No errors found");
+	return ok;
 }
 
 void Json::parse(const std::vector<JsonToken>& tokens) {
-	using json_map = std::unordered_map<std::string, std::shared_ptr<JsonValue>>;
-	using json_list = std::vector<std::shared_ptr<JsonValue>>;
+	using json_map = JsonMapData;
+	using json_list = JsonListData;
 	using json_stack = std::vector<std::shared_ptr<JsonValue>>;
 	using json_value_sptr = std::shared_ptr<JsonValue>;
 
@@ -444,12 +736,12 @@ void Json::parse(const std::vector<JsonToken>& tokens) {
 	json_value_sptr			new_value_ptr		= nullptr;
 
 	std::string				last_literal;
-	std::string				last_key;
+	JsonStringData			last_key(resource);
 	bool					string_flag			= false;
 	JsonToken				prev_token;
 
-	if (root->type() == JSON_MAP)			current_map_ptr = root->getMapPtr();
-	else if (root->type() == JSON_VECTOR)	list_ptr = root->getListPtr();
+	if (root && root->type() == JSON_MAP)			current_map_ptr = root->getMapPtr();
+	else if (root && root->type() == JSON_VECTOR)	list_ptr = root->getListPtr();
 
 	auto recompute_current_map = [&]() {
 		current_map_ptr = nullptr;
@@ -465,19 +757,19 @@ void Json::parse(const std::vector<JsonToken>& tokens) {
 		switch (token.type) {
 		case CBRACKETS_OPEN: {
 			if (json_ptrs_stack.empty()) {
-				root = std::make_shared<JsonMap>();
+				root = makeNode<JsonMap>(resource);
 				json_ptrs_stack.push_back(root);
 				current_map_ptr = root->getMapPtr();
 			}
 			else if (json_ptrs_stack.back()->type() == JSON_VECTOR) {
 				list_ptr = json_ptrs_stack.back()->getListPtr();
-				list_ptr->push_back(std::make_shared<JsonMap>());
+				list_ptr->push_back(makeNode<JsonMap>(resource));
 				inner_value_ptr = list_ptr->back();
 				json_ptrs_stack.push_back(inner_value_ptr);
 				current_map_ptr = inner_value_ptr->getMapPtr();
 			}
 			else {
-				(*current_map_ptr)[last_key] = std::make_shared<JsonMap>();
+				(*current_map_ptr)[last_key] = makeNode<JsonMap>(resource);
 				inner_value_ptr = (*current_map_ptr)[last_key];
 				json_ptrs_stack.push_back(inner_value_ptr);
 				current_map_ptr = inner_value_ptr->getMapPtr();
@@ -496,7 +788,7 @@ void Json::parse(const std::vector<JsonToken>& tokens) {
 			break;
 		}
 		case SBRACKETS_OPEN: {
-			new_value_ptr = std::make_shared<JsonList>();
+			new_value_ptr = makeNode<JsonList>(resource);
 			if (json_ptrs_stack.empty()) {
 				root = new_value_ptr;
 				json_ptrs_stack.push_back(root);
@@ -520,7 +812,10 @@ void Json::parse(const std::vector<JsonToken>& tokens) {
 				list_ptr = json_ptrs_stack.back()->getListPtr();
 				list_ptr->push_back(last_value_ptr);
 			}
-			if (!json_ptrs_stack.empty()) json_ptrs_stack.pop_back();
+			if (!json_ptrs_stack.empty()) {
+				static_cast<JsonList&>(*json_ptrs_stack.back()).pack();
+				json_ptrs_stack.pop_back();
+			}
 			recompute_current_map();
 			break;
 		}
@@ -546,19 +841,19 @@ void Json::parse(const std::vector<JsonToken>& tokens) {
 		case LITERAL: {
 			last_literal = token.value;
 			if (string_flag) {
-				last_value_ptr = std::make_shared<JsonString>(token.value);
+				last_value_ptr = makeNode<JsonString>(resource, token.value);
 			}
 			else if (token.value == "true") {
-				last_value_ptr = std::make_shared<JsonBool>(true);
+				last_value_ptr = makeNode<JsonBool>(resource, true);
 			}
 			else if (token.value == "false") {
-				last_value_ptr = std::make_shared<JsonBool>(false);
+				last_value_ptr = makeNode<JsonBool>(resource, false);
 			}
 			else if (token.value == "null") {
-				last_value_ptr = std::make_shared<JsonNull>();
+				last_value_ptr = makeNode<JsonNull>(resource);
 			}
 			else {
-				last_value_ptr = std::make_shared<JsonDouble>(std::stod(token.value));
+				last_value_ptr = makeNode<JsonDouble>(resource, std::stod(token.value));
 			}
 			break;
 		}
@@ -566,146 +861,1787 @@ void Json::parse(const std::vector<JsonToken>& tokens) {
 
 		prev_token = token;
 	}
+	if (!root) root = last_value_ptr;
+}
+
+// Single pass recursive descent parser behind Json::tryParse. Nodes are built while scanning, the
+// first error stops the parse, and ParseLimits::max_depth bounds the recursion.
+class BoundedParser {
+public:
+	BoundedParser(std::string_view input, const ParseLimits& limits, std::pmr::memory_resource* resource,
+		ParseBuffers& buffers, const Schema* schema, const Projection* projection, ParseError& error)
+		: input(input), limits(limits), resource(resource), buffers(buffers), schema(schema), projection(projection), error(error) {}
+
+	std::shared_ptr<JsonValue> parseDocument() {
+		std::shared_ptr<JsonValue> root = parseRoot();
+		// A failed parse leaves the elements of the containers it was in; clear() keeps the capacity.
+		buffers.values.clear();
+		buffers.entries.clear();
+		buffers.required_seen.clear();
+		buffers.packed.clear();
+		return root;
+	}
+
+private:
+	std::string_view input;
+	const ParseLimits& limits;
+	std::pmr::memory_resource* resource;
+	ParseBuffers& buffers;
+	const Schema* schema;
+	const Projection* projection;
+	ParseError& error;
+	size_t pos = 0;
+	size_t elements = 0;
+
+	std::shared_ptr<JsonValue> parseRoot() {
+		std::shared_ptr<JsonValue> root;
+		if (input.size() > limits.max_document_size) { fail(JSON_LIMIT_EXCEEDED, "Document exceeds max_document_size"); return nullptr; }
+		skipWhitespace();
+		if (pos == input.size()) { fail(JSON_EMPTY, "Empty JSON input"); return nullptr; }
+		if (!parseValue(root, 0, schema ? &schema->root() : nullptr, projection ? &projection->root() : nullptr)) return nullptr;
+		skipWhitespace();
+		if (pos != input.size()) { fail(JSON_UNEXPECTED_SYMBOL, "Extra data after root value"); return nullptr; }
+		error = ParseError(JSON_OK, "No errors found");
+		return root;
+	}
+
+	bool fail(JsonParseErrors id, const std::string& what) {
+		size_t end = std::min(pos, input.size());
+		int line = 1, column = 1;
+		for (size_t i = 0; i < end; ++i) {
+			if (input[i] == '\n') { ++line; column = 1; }
+			else ++column;
+		}
+		error = ParseError(id, what, line, column);
+		return false;
+	}
+
+	void skipWhitespace() {
+		while (pos < input.size() && (input[pos] == ' ' || input[pos] == '\n' || input[pos] == '\r' || input[pos] == '\t')) ++pos;
+	}
+
+	// Schema type bit of the value starting with c; anything that is not a value start passes so the syntax error wins.
+	static unsigned valueKind(char c) {
+		switch (c) {
+		case '{': return SCHEMA_OBJECT;
+		case '[': return SCHEMA_ARRAY;
+		case '"': return SCHEMA_STRING;
+		case 't': case 'f': return SCHEMA_BOOLEAN;
+		case 'n': return SCHEMA_NULL;
+		default:
+			if (c == '-' || (c >= '0' && c <= '9')) return SCHEMA_NUMBER | SCHEMA_INTEGER;
+			return SCHEMA_ANY;
+		}
+	}
+
+	// selection is the projection node for this value, nullptr when the whole value is wanted.
+	bool parseValue(std::shared_ptr<JsonValue>& out, size_t depth, const Schema::Node* rule, const Projection::Node* selection) {
+		skipWhitespace();
+		if (pos == input.size()) return fail(JSON_MISSING_VALUE, "Value is not found");
+		// Inside a path only containers lead on to its end; a scalar there is checked and left out, out stays empty.
+		if (selection && input[pos] != '{' && input[pos] != '[') return skipValue(depth);
+		if (++elements > limits.max_elements) return fail(JSON_LIMIT_EXCEEDED, "Document exceeds max_elements");
+		if (rule && !(rule->types & valueKind(input[pos]))) return fail(JSON_SCHEMA_MISMATCH, "Value type does not match schema");
+
+		switch (input[pos]) {
+		case '{': return parseObject(out, depth, rule, selection);
+		case '[': return parseList(out, depth, rule, selection);
+		case '"': {
+			size_t start = pos;
+			std::string_view str;
+			if (!parseString(str)) return false;
+			if (rule) {
+				if (const char* what = checkString(*rule, str)) { pos = start; return fail(JSON_SCHEMA_MISMATCH, what); }
+			}
+			out = makeNode<JsonString>(resource, str);
+			return true;
+		}
+		case 't':
+			if (rule && rule->has_enum && !rule->enum_true) return fail(JSON_SCHEMA_MISMATCH, "Value is not in the schema enum");
+			if (!expectLiteral("true")) return false;
+			out = makeNode<JsonBool>(resource, true);
+			return true;
+		case 'f':
+			if (rule && rule->has_enum && !rule->enum_false) return fail(JSON_SCHEMA_MISMATCH, "Value is not in the schema enum");
+			if (!expectLiteral("false")) return false;
+			out = makeNode<JsonBool>(resource, false);
+			return true;
+		case 'n':
+			if (rule && rule->has_enum && !rule->enum_null) return fail(JSON_SCHEMA_MISMATCH, "Value is not in the schema enum");
+			if (!expectLiteral("null")) return false;
+			out = makeNode<JsonNull>(resource);
+			return true;
+		default:
+			if (input[pos] == '-' || (input[pos] >= '0' && input[pos] <= '9')) return parseNumber(out, rule);
+			return fail(JSON_UNEXPECTED_SYMBOL, "Unexpected symbol where expecting value");
+		}
+	}
+
+	bool parseObject(std::shared_ptr<JsonValue>& out, size_t depth, const Schema::Node* rule, const Projection::Node* selection) {
+		if (depth >= limits.max_depth) return fail(JSON_LIMIT_EXCEEDED, "Maximum nesting depth exceeded");
+		++pos;
+		// Entries of this object are stacked above base until the closing brace.
+		const size_t base = buffers.entries.size();
+		const size_t required_base = buffers.required_seen.size();
+		if (rule) buffers.required_seen.resize(required_base + rule->required.size(), 0);
+
+		skipWhitespace();
+		bool empty = pos < input.size() && input[pos] == '}';
+		while (!empty) {
+			skipWhitespace();
+			if (pos == input.size() || input[pos] != '"') return fail(JSON_INVALID_KEY, "Invalid or missing key string");
+			size_t key_start = pos;
+			std::string_view key_view;
+			if (!parseString(key_view)) return false;
+			skipWhitespace();
+			if (pos == input.size() || input[pos] != ':') return fail(JSON_MISSING_SYMBOL, "Expected ':' after key");
+			++pos;
+
+			const Schema::Node* value_rule = nullptr;
+			if (rule) {
+				auto property = rule->properties.find(key_view);
+				if (property != rule->properties.end()) {
+					value_rule = &schema->node(property->second.schema);
+					if (property->second.required_slot != Schema::npos) buffers.required_seen[required_base + property->second.required_slot] = 1;
+				}
+				else if (!rule->additional_allowed) {
+					pos = key_start;
+					return fail(JSON_SCHEMA_MISMATCH, "Key '" + std::string(key_view) + "' is not allowed by schema");
+				}
+				else if (rule->additional != Schema::npos) {
+					value_rule = &schema->node(rule->additional);
+				}
+			}
+			bool skip = value_rule && value_rule->ignore;
+			const Projection::Node* value_selection = nullptr;
+			if (selection) {
+				auto child = selection->children.find(key_view);
+				if (child == selection->children.end()) skip = true;
+				else if (!projection->node(child->second).whole) value_selection = &projection->node(child->second);
+			}
+			if (skip) {
+				if (!skipValue(depth + 1)) return false;
+			}
+			else {
+				// The key may live in the scratch buffer, which the value is about to reuse.
+				JsonStringData key(key_view, resource);
+				std::shared_ptr<JsonValue> value;
+				if (!parseValue(value, depth + 1, value_rule, value_selection)) return false;
+				if (value) buffers.entries.emplace_back(std::move(key), std::move(value));
+			}
+
+			skipWhitespace();
+			if (pos == input.size()) return fail(JSON_MISSING_SYMBOL, "Missing closing '}' for object");
+			if (input[pos] == ',') { ++pos; continue; }
+			if (input[pos] == '}') break;
+			return fail(JSON_UNEXPECTED_SYMBOL, "Expected ',' or '}' in object");
+		}
+		if (rule) {
+			for (size_t slot = 0; slot < rule->required.size(); ++slot) {
+				if (!buffers.required_seen[required_base + slot]) return fail(JSON_SCHEMA_MISMATCH, "Missing required key '" + rule->required[slot] + "'");
+			}
+			buffers.required_seen.resize(required_base);
+		}
+		++pos;
+		auto object = makeNode<JsonMap>(resource);
+		JsonMapData& map = *object->getMapPtr();
+		auto first = buffers.entries.begin() + base;
+		map.reserve(buffers.entries.end() - first);
+		for (auto it = first; it != buffers.entries.end(); ++it) map.insert_or_assign(std::move(it->first), std::move(it->second));
+		buffers.entries.erase(first, buffers.entries.end());
+		out = std::move(object);
+		return true;
+	}
+
+	// A projection applies to every element of a list, so scalar elements are dropped and nothing is packed.
+	bool parseList(std::shared_ptr<JsonValue>& out, size_t depth, const Schema::Node* rule, const Projection::Node* selection) {
+		if (depth >= limits.max_depth) return fail(JSON_LIMIT_EXCEEDED, "Maximum nesting depth exceeded");
+		++pos;
+		const Schema::Node* item_rule = rule && rule->items != Schema::npos ? &schema->node(rule->items) : nullptr;
+		const size_t base = buffers.values.size();
+		// Elements are staged unboxed while they are all numbers or all booleans.
+		const size_t packed_base = buffers.packed.size();
+		JsonListStorage storage = LIST_BOXED;
+		bool packable = selection == nullptr;
+
+		skipWhitespace();
+		bool empty = pos < input.size() && input[pos] == ']';
+		while (!empty) {
+			skipWhitespace();
+			size_t count = buffers.values.size() - base + buffers.packed.size() - packed_base;
+			if (rule && count == rule->max_items) return fail(JSON_SCHEMA_MISMATCH, "List has more items than the schema allows");
+			if (packable) {
+				JsonListStorage kind = pos < input.size() ? packedKind(input[pos]) : LIST_BOXED;
+				if (kind != LIST_BOXED && (count == 0 || kind == storage)) {
+					storage = kind;
+					double value = 0;
+					if (!parsePacked(value, kind, item_rule)) return false;
+					buffers.packed.push_back(value);
+				}
+				else {
+					packable = false;
+					unpack(packed_base, storage);
+				}
+			}
+			if (!packable) {
+				std::shared_ptr<JsonValue> value;
+				if (!parseValue(value, depth + 1, item_rule, selection)) return false;
+				if (value) buffers.values.push_back(std::move(value));
+			}
+
+			skipWhitespace();
+			if (pos == input.size()) return fail(JSON_MISSING_SYMBOL, "Missing closing ']' for list");
+			if (input[pos] == ',') { ++pos; continue; }
+			if (input[pos] == ']') break;
+			return fail(JSON_UNEXPECTED_SYMBOL, "Expected ',' or ']' in list");
+		}
+		if (rule && buffers.values.size() - base + buffers.packed.size() - packed_base < rule->min_items) {
+			return fail(JSON_SCHEMA_MISMATCH, "List has fewer items than the schema requires");
+		}
+		++pos;
+		auto list = makeNode<JsonList>(resource);
+		if (packable && storage != LIST_BOXED) {
+			auto first = buffers.packed.begin() + packed_base;
+			if (storage == LIST_NUMBERS) list->assignNumbers(first, buffers.packed.end());
+			else list->assignBools(first, buffers.packed.end());
+			buffers.packed.erase(first, buffers.packed.end());
+		}
+		else {
+			auto first = buffers.values.begin() + base;
+			list->getListPtr()->assign(std::make_move_iterator(first), std::make_move_iterator(buffers.values.end()));
+			buffers.values.erase(first, buffers.values.end());
+		}
+		out = std::move(list);
+		return true;
+	}
+
+	static JsonListStorage packedKind(char c) {
+		if (c == '-' || (c >= '0' && c <= '9')) return LIST_NUMBERS;
+		if (c == 't' || c == 'f') return LIST_BOOLS;
+		return LIST_BOXED;
+	}
+
+	// parseValue for a number or boolean that goes into a list unboxed; booleans are staged as 0 and 1.
+	bool parsePacked(double& value, JsonListStorage kind, const Schema::Node* rule) {
+		if (++elements > limits.max_elements) return fail(JSON_LIMIT_EXCEEDED, "Document exceeds max_elements");
+		if (rule && !(rule->types & valueKind(input[pos]))) return fail(JSON_SCHEMA_MISMATCH, "Value type does not match schema");
+		if (kind == LIST_NUMBERS) return parseDouble(value, rule);
+		bool flag = input[pos] == 't';
+		if (rule && rule->has_enum && !(flag ? rule->enum_true : rule->enum_false)) return fail(JSON_SCHEMA_MISMATCH, "Value is not in the schema enum");
+		if (!expectLiteral(flag ? "true" : "false")) return false;
+		value = flag;
+		return true;
+	}
+
+	// Boxes the elements staged so far once a list turns out to hold other values too.
+	void unpack(size_t packed_base, JsonListStorage storage) {
+		for (size_t i = packed_base; i < buffers.packed.size(); ++i) {
+			if (storage == LIST_NUMBERS) buffers.values.push_back(makeNode<JsonDouble>(resource, buffers.packed[i]));
+			else buffers.values.push_back(makeNode<JsonBool>(resource, buffers.packed[i] != 0));
+		}
+		buffers.packed.resize(packed_base);
+	}
+
+	// Checks the syntax of a value without building it, for keys outside the projection and properties the
+	// schema marks as ignored: strings are validated but not decoded and numbers are not converted.
+	bool skipValue(size_t depth) {
+		skipWhitespace();
+		if (pos == input.size()) return fail(JSON_MISSING_VALUE, "Value is not found");
+		if (++elements > limits.max_elements) return fail(JSON_LIMIT_EXCEEDED, "Document exceeds max_elements");
+		switch (input[pos]) {
+		case '{':
+		case '[': {
+			const bool is_object = input[pos] == '{';
+			const char close = is_object ? '}' : ']';
+			if (depth >= limits.max_depth) return fail(JSON_LIMIT_EXCEEDED, "Maximum nesting depth exceeded");
+			++pos;
+			skipWhitespace();
+			if (pos < input.size() && input[pos] == close) { ++pos; return true; }
+			while (true) {
+				if (is_object) {
+					skipWhitespace();
+					if (pos == input.size() || input[pos] != '"') return fail(JSON_INVALID_KEY, "Invalid or missing key string");
+					if (!skipString()) return false;
+					skipWhitespace();
+					if (pos == input.size() || input[pos] != ':') return fail(JSON_MISSING_SYMBOL, "Expected ':' after key");
+					++pos;
+				}
+				if (!skipValue(depth + 1)) return false;
+				skipWhitespace();
+				if (pos == input.size()) return fail(JSON_MISSING_SYMBOL, is_object ? "Missing closing '}' for object" : "Missing closing ']' for list");
+				if (input[pos] == ',') { ++pos; continue; }
+				if (input[pos] == close) { ++pos; return true; }
+				return fail(JSON_UNEXPECTED_SYMBOL, is_object ? "Expected ',' or '}' in object" : "Expected ',' or ']' in list");
+			}
+		}
+		case '"': return skipString();
+		case 't': return expectLiteral("true");
+		case 'f': return expectLiteral("false");
+		case 'n': return expectLiteral("null");
+		default: {
+			if (input[pos] != '-' && (input[pos] < '0' || input[pos] > '9')) return fail(JSON_UNEXPECTED_SYMBOL, "Unexpected symbol where expecting value");
+			return scanNumber();
+		}
+		}
+	}
+
+	bool skipString() {
+		size_t start = pos;
+		if (const char* what = validate_json_string(input, pos)) return fail(JSON_INVALID_STRING, what);
+		++pos;
+		if (pos - start - 2 > limits.max_string_length) return fail(JSON_LIMIT_EXCEEDED, "String exceeds max_string_length");
+		return true;
+	}
+
+	static const char* checkString(const Schema::Node& rule, std::string_view str) {
+		if (rule.min_length > 0 || rule.max_length != Schema::npos) {
+			// Lengths count code points, as in JSON Schema.
+			size_t length = 0;
+			for (char c : str) length += (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+			if (length < rule.min_length) return "String is shorter than the schema minLength";
+			if (length > rule.max_length) return "String is longer than the schema maxLength";
+		}
+		if (rule.has_enum && std::find(rule.enum_strings.begin(), rule.enum_strings.end(), str) == rule.enum_strings.end())
+			return "Value is not in the schema enum";
+		return nullptr;
+	}
+
+	static const char* checkNumber(const Schema::Node& rule, double value) {
+		if (!(rule.types & SCHEMA_NUMBER) && value != std::floor(value)) return "Number is not an integer";
+		if (value < rule.minimum || value <= rule.exclusive_minimum) return "Number is below the schema minimum";
+		if (value > rule.maximum || value >= rule.exclusive_maximum) return "Number is above the schema maximum";
+		if (rule.has_enum && std::find(rule.enum_numbers.begin(), rule.enum_numbers.end(), value) == rule.enum_numbers.end())
+			return "Value is not in the schema enum";
+		return nullptr;
+	}
+
+	// Strings without escapes are returned as a view into the input, the rest are decoded into scratch.
+	bool parseString(std::string_view& out) {
+		const char* data = input.data();
+		size_t run = find_string_special(data, pos + 1, input.size());
+		while (run < input.size() && static_cast<unsigned char>(data[run]) >= 0x80) {
+			run = skip_utf8_run(data, run, input.size());
+			if (run < input.size() && static_cast<unsigned char>(data[run]) >= 0x80) break;
+			run = find_string_special(data, run, input.size());
+		}
+		if (run < input.size() && input[run] == '"') {
+			out = input.substr(pos + 1, run - pos - 1);
+			pos = run + 1;
+		}
+		else {
+			if (const char* what = decode_json_string(input, pos, buffers.scratch)) return fail(JSON_INVALID_STRING, what);
+			out = buffers.scratch;
+			++pos;
+		}
+		if (out.size() > limits.max_string_length) return fail(JSON_LIMIT_EXCEEDED, "String exceeds max_string_length");
+		return true;
+	}
+
+	bool expectLiteral(std::string_view literal) {
+		if (input.compare(pos, literal.size(), literal) != 0) return fail(JSON_INVALID_LITERAL, "Invalid literal");
+		pos += literal.size();
+		return true;
+	}
+
+	// Moves pos past a number, checking its syntax only.
+	bool scanNumber() {
+		auto digits = [&]() { size_t from = pos; while (pos < input.size() && input[pos] >= '0' && input[pos] <= '9') ++pos; return pos - from; };
+
+		if (input[pos] == '-') ++pos;
+		if (pos < input.size() && input[pos] == '0') ++pos;
+		else if (digits() == 0) return fail(JSON_INVALID_LITERAL, "Invalid number");
+		if (pos < input.size() && input[pos] == '.') {
+			++pos;
+			if (digits() == 0) return fail(JSON_INVALID_LITERAL, "Invalid number fraction");
+		}
+		if (pos < input.size() && (input[pos] == 'e' || input[pos] == 'E')) {
+			++pos;
+			if (pos < input.size() && (input[pos] == '+' || input[pos] == '-')) ++pos;
+			if (digits() == 0) return fail(JSON_INVALID_LITERAL, "Invalid number exponent");
+		}
+		return true;
+	}
+
+	bool parseDouble(double& value, const Schema::Node* rule) {
+		size_t start = pos;
+		if (!scanNumber()) return false;
+		auto [end, ec] = std::from_chars(input.data() + start, input.data() + pos, value);
+		if (ec != std::errc() || end != input.data() + pos) return fail(JSON_INVALID_LITERAL, "Number out of range");
+		if (rule) {
+			if (const char* what = checkNumber(*rule, value)) { pos = start; return fail(JSON_SCHEMA_MISMATCH, what); }
+		}
+		return true;
+	}
+
+	bool parseNumber(std::shared_ptr<JsonValue>& out, const Schema::Node* rule) {
+		double value = 0;
+		if (!parseDouble(value, rule)) return false;
+		out = makeNode<JsonDouble>(resource, value);
+		return true;
+	}
+};
+
+ParseResult Json::parseBounded(std::string_view input, const ParseLimits& limits, std::pmr::memory_resource* resource,
+	ParseBuffers& buffers, const Schema* schema, const Projection* projection) {
+	ParseError error;
+	std::shared_ptr<JsonValue> root;
+	{
+		SMPJ_STATS(StatsScope stats_scope(OP_PARSE, &root, nullptr, &error));
+		SMPJ_STATS(stats_scope.stats.input_bytes = input.size());
+		SMPJ_STATS(stats_scope.begin());
+		root = BoundedParser(input, limits, resource, buffers, schema, projection, error).parseDocument();
+		SMPJ_STATS(stats_scope.end(PHASE_PARSE));
+	}
+	if (!root) root = makeNode<JsonMap>(resource);
+	return ParseResult{ Json(std::move(root), resource), std::move(error) };
+}
+
+ParseResult Json::tryParse(std::string_view input, const ParseLimits& limits, std::pmr::memory_resource* resource) {
+	ParseBuffers buffers;
+	return parseBounded(input, limits, resource, buffers, nullptr, nullptr);
+}
+
+ParseResult Json::tryParse(std::string_view input, const Schema& schema, const ParseLimits& limits, std::pmr::memory_resource* resource) {
+	ParseBuffers buffers;
+	return parseBounded(input, limits, resource, buffers, &schema, nullptr);
+}
+
+ParseResult Json::tryParse(std::string_view input, const Projection& projection, const ParseLimits& limits, std::pmr::memory_resource* resource) {
+	ParseBuffers buffers;
+	return parseBounded(input, limits, resource, buffers, nullptr, &projection);
+}
+
+Parser::Parser(const ParseLimits& limits, std::pmr::memory_resource* resource)
+	: limits(limits), pool(resource ? nullptr : std::make_unique<std::pmr::unsynchronized_pool_resource>()),
+	resource(resource ? resource : pool.get()) {}
+
+ParseResult Parser::parse(std::string_view input) {
+	return Json::parseBounded(input, limits, resource, buffers, nullptr, nullptr);
+}
+
+ParseResult Parser::parse(std::string_view input, const Schema& schema) {
+	return Json::parseBounded(input, limits, resource, buffers, &schema, nullptr);
+}
+
+ParseResult Parser::parse(std::string_view input, const Projection& projection) {
+	return Json::parseBounded(input, limits, resource, buffers, nullptr, &projection);
+}
+
+PushParser::PushParser(const ParseLimits& limits, std::pmr::memory_resource* resource)
+	: limits(limits), resource(resource), decoded(resource) {}
+
+bool PushParser::feed(const char* data, size_t size) {
+	if (has_failed) return false;
+	SMPJ_STATS(auto feed_start = std::chrono::steady_clock::now());
+	bytes_fed += size;
+	if (bytes_fed > limits.max_document_size) return fail(JSON_LIMIT_EXCEEDED, "Document exceeds max_document_size", data, 0);
+
+	size_t i = 0;
+	if (token != TOKEN_NONE) {
+		token_start = 0;
+		if (!scanToken(data, size, i)) return false;
+	}
+	while (i < size) {
+		char c = data[i];
+		if (c == ' ' || c == '\n' || c == '\r' || c == '\t') { ++i; continue; }
+		if (!step(data, size, i)) return false;
+	}
+	advance(data, size);
+	SMPJ_STATS(parse_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - feed_start).count());
+	return true;
+}
+
+ParseResult PushParser::finish() {
+	if (!has_failed) {
+		if (token == TOKEN_NUMBER) endNumber(token_text, nullptr, 0);
+		else if (token == TOKEN_STRING || token == TOKEN_KEY) fail(JSON_INVALID_STRING, "Unterminated string", nullptr, 0);
+		else if (token == TOKEN_LITERAL) fail(JSON_INVALID_LITERAL, "Invalid literal", nullptr, 0);
+	}
+	if (!has_failed) {
+		if (!root) fail(JSON_EMPTY, "Empty JSON input", nullptr, 0);
+		else if (expect == EXPECT_VALUE || expect == EXPECT_VALUE_OR_CLOSE) fail(JSON_MISSING_VALUE, "Value is not found", nullptr, 0);
+		else if (expect == EXPECT_KEY || expect == EXPECT_KEY_OR_CLOSE) fail(JSON_INVALID_KEY, "Invalid or missing key string", nullptr, 0);
+		else if (expect == EXPECT_COLON) fail(JSON_MISSING_SYMBOL, "Expected ':' after key", nullptr, 0);
+		else if (!stack.empty()) fail(JSON_MISSING_SYMBOL, stack.back().map ? "Missing closing '}' for object" : "Missing closing ']' for list", nullptr, 0);
+		else parse_error = ParseError(JSON_OK, "No errors found");
+	}
+
+	std::shared_ptr<JsonValue> document = has_failed ? nullptr : std::move(root);
+	ParseError error = std::move(parse_error);
+	{
+		SMPJ_STATS(StatsScope stats_scope(OP_PARSE, &document, nullptr, &error));
+		SMPJ_STATS(stats_scope.stats.input_bytes = bytes_fed);
+		SMPJ_STATS(stats_scope.stats.phase_ns[PHASE_PARSE] = parse_ns);
+	}
+	reset();
+	if (!document) document = makeNode<JsonMap>(resource);
+	return ParseResult{ Json(std::move(document), resource), std::move(error) };
+}
+
+bool PushParser::step(const char* data, size_t size, size_t& i) {
+	char c = data[i];
+	switch (expect) {
+	case EXPECT_END:
+		return fail(JSON_UNEXPECTED_SYMBOL, "Extra data after root value", data, i);
+	case EXPECT_COLON:
+		if (c != ':') return fail(JSON_MISSING_SYMBOL, "Expected ':' after key", data, i);
+		++i;
+		expect = EXPECT_VALUE;
+		return true;
+	case EXPECT_COMMA_OR_CLOSE:
+		if (c == ',') {
+			++i;
+			expect = stack.back().map ? EXPECT_KEY : EXPECT_VALUE;
+			return true;
+		}
+		if (c == '}' || c == ']') return close(data, i);
+		return fail(JSON_UNEXPECTED_SYMBOL, stack.back().map ? "Expected ',' or '}' in object" : "Expected ',' or ']' in list", data, i);
+	case EXPECT_KEY_OR_CLOSE:
+		if (c == '}') return close(data, i);
+		[[fallthrough]];
+	case EXPECT_KEY:
+		if (c != '"') return fail(JSON_INVALID_KEY, "Invalid or missing key string", data, i);
+		token = TOKEN_KEY;
+		token_start = i++;
+		return scanString(data, size, i);
+	case EXPECT_VALUE_OR_CLOSE:
+		if (c == ']') return close(data, i);
+		[[fallthrough]];
+	case EXPECT_VALUE:
+		return startValue(data, size, i);
+	}
+	return true;
+}
+
+bool PushParser::startValue(const char* data, size_t size, size_t& i) {
+	if (++elements > limits.max_elements) return fail(JSON_LIMIT_EXCEEDED, "Document exceeds max_elements", data, i);
+	char c = data[i];
+	if (c == '{' || c == '[') {
+		if (stack.size() >= limits.max_depth) return fail(JSON_LIMIT_EXCEEDED, "Maximum nesting depth exceeded", data, i);
+		JsonMapData* map = nullptr;
+		JsonList* list = nullptr;
+		if (c == '{') {
+			auto object = makeNode<JsonMap>(resource);
+			map = object->getMapPtr();
+			attach(std::move(object));
+		}
+		else {
+			auto array = makeNode<JsonList>(resource);
+			list = array.get();
+			attach(std::move(array));
+		}
+		stack.push_back(Frame{ list, map, JsonStringData(resource) });
+		expect = map ? EXPECT_KEY_OR_CLOSE : EXPECT_VALUE_OR_CLOSE;
+		++i;
+		return true;
+	}
+	token_start = i;
+	switch (c) {
+	case '"':
+		token = TOKEN_STRING;
+		++i;
+		return scanString(data, size, i);
+	case 't': literal = "true"; break;
+	case 'f': literal = "false"; break;
+	case 'n': literal = "null"; break;
+	default:
+		if (c != '-' && (c < '0' || c > '9')) return fail(JSON_UNEXPECTED_SYMBOL, "Unexpected symbol where expecting value", data, i);
+		token = TOKEN_NUMBER;
+		number_state = NUMBER_START;
+		return scanToken(data, size, i);
+	}
+	token = TOKEN_LITERAL;
+	literal_matched = 0;
+	return scanToken(data, size, i);
+}
+
+bool PushParser::close(const char* data, size_t& i) {
+	if ((data[i] == '}') != (stack.back().map != nullptr)) {
+		return fail(JSON_UNEXPECTED_SYMBOL, stack.back().map ? "Expected ',' or '}' in object" : "Expected ',' or ']' in list", data, i);
+	}
+	stack.pop_back();
+	++i;
+	valueDone();
+	return true;
+}
+
+// Continues the token in progress from data[i]; a token that runs to the end of the chunk is carried over.
+bool PushParser::scanToken(const char* data, size_t size, size_t& i) {
+	switch (token) {
+	case TOKEN_STRING:
+	case TOKEN_KEY:
+		return scanString(data, size, i);
+	case TOKEN_NUMBER:
+		while (i < size && numberAccepts(data[i])) ++i;
+		if (i == size) return carry(data, size);
+		if (token_text.empty()) return endNumber(std::string_view(data + token_start, i - token_start), data, i);
+		token_text.append(data + token_start, i - token_start);
+		return endNumber(token_text, data, i);
+	case TOKEN_LITERAL: {
+		size_t length = std::strlen(literal);
+		for (; i < size && literal_matched < length; ++i, ++literal_matched) {
+			if (data[i] != literal[literal_matched]) return fail(JSON_INVALID_LITERAL, "Invalid literal", data, i);
+		}
+		if (literal_matched < length) return true;
+		token = TOKEN_NONE;
+		if (literal[0] == 'n') attach(makeNode<JsonNull>(resource));
+		else attachBool(literal[0] == 't');
+		valueDone();
+		return true;
+	}
+	case TOKEN_NONE:
+		break;
+	}
+	return true;
 }
 
-void Json::writeToFile(std::fstream& file_stream, const std::string& path) {
+// Decodes the string from data[i] up to its closing quote or the end of the chunk. An escape or UTF-8 sequence
+// cut by the end of the chunk waits in pending and is completed from the start of the next one.
+bool PushParser::scanString(const char* data, size_t size, size_t& i) {
+	const char* what = nullptr;
+	if (!pending.empty()) {
+		// No escape is longer than 12 bytes, so this either completes the unit or takes the whole chunk.
+		size_t carried = pending.size();
+		size_t take = std::min(size - i, size_t(12));
+		pending.append(data + i, take);
+		size_t at = 0;
+		Unit unit = decodeUnit(pending.data(), pending.size(), at, what);
+		if (unit == UNIT_INVALID) return fail(JSON_INVALID_STRING, what, data, i);
+		if (unit == UNIT_INCOMPLETE) {
+			i += take;
+			return true;
+		}
+		i += at - carried;
+		pending.clear();
+	}
+	while (true) {
+		size_t stop = find_string_special(data, i, size);
+		appendDecoded(data + i, stop - i);
+		i = stop;
+		if (i == size) return true;
+		unsigned char current = static_cast<unsigned char>(data[i]);
+		if (current == '"') return endString(data, ++i);
+		if (current >= 0x80) {
+			size_t run_end = skip_utf8_run(data, i, size);
+			appendDecoded(data + i, run_end - i);
+			i = run_end;
+			if (i == size || static_cast<unsigned char>(data[i]) < 0x80) continue;
+		}
+		else if (current != '\\') return fail(JSON_INVALID_STRING, "Unescaped control character in string", data, i);
+
+		size_t at = i;
+		Unit unit = decodeUnit(data, size, at, what);
+		if (unit == UNIT_INVALID) return fail(JSON_INVALID_STRING, what, data, i);
+		if (unit == UNIT_INCOMPLETE) {
+			pending.assign(data + i, size - i);
+			i = size;
+			return true;
+		}
+		i = at;
+	}
+}
+
+// Decodes the escape or multi-byte sequence at data[at] into decoded and moves at past it. Incomplete means
+// the unit may still turn out valid once more bytes arrive; decode_unicode_escape needs up to 12.
+PushParser::Unit PushParser::decodeUnit(const char* data, size_t size, size_t& at, const char*& what) {
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	if (data[at] != '\\') {
+		size_t expected = utf8_expected_length(bytes[at]);
+		if (expected != 0 && expected > size - at) return UNIT_INCOMPLETE;
+		size_t length = expected == 0 ? 0 : utf8_sequence_length(bytes + at, size - at);
+		if (length == 0) { what = "Invalid UTF-8 sequence in string"; return UNIT_INVALID; }
+		appendDecoded(data + at, length);
+		at += length;
+		return UNIT_DONE;
+	}
+	if (at + 1 >= size) return UNIT_INCOMPLETE;
+	char escaped = data[at + 1];
+	switch (escaped) {
+	case '"':  case '\\': case '/':	appendDecoded(&escaped, 1); break;
+	case 'b':	appendDecoded("\b", 1); break;
+	case 'f':	appendDecoded("\f", 1); break;
+	case 'n':	appendDecoded("\n", 1); break;
+	case 'r':	appendDecoded("\r", 1); break;
+	case 't':	appendDecoded("\t", 1); break;
+	case 'u': {
+		uint32_t code_point = 0;
+		size_t consumed = decode_unicode_escape(data + at + 2, size - at - 2, code_point, what);
+		if (consumed == 0) return size - at < 12 ? UNIT_INCOMPLETE : UNIT_INVALID;
+		std::string utf8;
+		append_utf8(utf8, code_point);
+		appendDecoded(utf8.data(), utf8.size());
+		at += consumed;
+		break;
+	}
+	default:
+		what = "Invalid escape";
+		return UNIT_INVALID;
+	}
+	at += 2;
+	return UNIT_DONE;
+}
+
+// Past max_string_length the contents are dropped, but the string is still checked to its end so an invalid
+// string reports JSON_INVALID_STRING as tryParse does.
+void PushParser::appendDecoded(const char* data, size_t size) {
+	if (string_too_long || size == 0) return;
+	decoded.append(data, size);
+	if (decoded.size() > limits.max_string_length) {
+		string_too_long = true;
+		decoded = JsonStringData(resource);
+	}
+}
+
+bool PushParser::endString(const char* data, size_t end) {
+	if (string_too_long) return fail(JSON_LIMIT_EXCEEDED, "String exceeds max_string_length", data, end - 1);
+	if (token == TOKEN_KEY) {
+		stack.back().key = std::move(decoded);
+		expect = EXPECT_COLON;
+	}
+	else {
+		attach(makeNode<JsonString>(resource, std::move(decoded)));
+		valueDone();
+	}
+	decoded.clear();
+	token = TOKEN_NONE;
+	return true;
+}
+
+// Advances number_state over c, or returns false if c cannot continue the number. The character that ends
+// a number is left for the main loop, as BoundedParser::scanNumber leaves it.
+bool PushParser::numberAccepts(char c) {
+	bool digit = c >= '0' && c <= '9';
+	bool exponent = c == 'e' || c == 'E';
+	switch (number_state) {
+	case NUMBER_START:
+		if (c == '-') { number_state = NUMBER_SIGN; return true; }
+		[[fallthrough]];
+	case NUMBER_SIGN:
+		if (!digit) return false;
+		number_state = c == '0' ? NUMBER_ZERO : NUMBER_INTEGER;
+		return true;
+	case NUMBER_INTEGER:
+		if (digit) return true;
+		[[fallthrough]];
+	case NUMBER_ZERO:
+		if (c == '.') number_state = NUMBER_DOT;
+		else if (exponent) number_state = NUMBER_EXPONENT;
+		else return false;
+		return true;
+	case NUMBER_DOT:
+		if (!digit) return false;
+		number_state = NUMBER_FRACTION;
+		return true;
+	case NUMBER_FRACTION:
+		if (digit) return true;
+		if (!exponent) return false;
+		number_state = NUMBER_EXPONENT;
+		return true;
+	case NUMBER_EXPONENT:
+		if (c == '+' || c == '-') { number_state = NUMBER_EXPONENT_SIGN; return true; }
+		[[fallthrough]];
+	case NUMBER_EXPONENT_SIGN:
+	case NUMBER_EXPONENT_DIGITS:
+		if (!digit) return false;
+		number_state = NUMBER_EXPONENT_DIGITS;
+		return true;
+	}
+	return false;
+}
+
+// at is the character after the number, where tryParse reports a malformed one.
+bool PushParser::endNumber(std::string_view text, const char* data, size_t at) {
+	switch (number_state) {
+	case NUMBER_START:
+	case NUMBER_SIGN:			return fail(JSON_INVALID_LITERAL, "Invalid number", data, at);
+	case NUMBER_DOT:			return fail(JSON_INVALID_LITERAL, "Invalid number fraction", data, at);
+	case NUMBER_EXPONENT:
+	case NUMBER_EXPONENT_SIGN:	return fail(JSON_INVALID_LITERAL, "Invalid number exponent", data, at);
+	default:					break;
+	}
+	double value = 0;
+	auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+	if (ec != std::errc() || end != text.data() + text.size()) return fail(JSON_INVALID_LITERAL, "Number out of range", data, at);
+	token_text.clear();
+	token = TOKEN_NONE;
+	attachNumber(value);
+	valueDone();
+	return true;
+}
+
+// Keeps the part of the current number that is in this chunk; max_document_size bounds how much that can be.
+bool PushParser::carry(const char* data, size_t size) {
+	token_text.append(data + token_start, size - token_start);
+	return true;
+}
+
+void PushParser::attach(std::shared_ptr<JsonValue> value) {
+	if (stack.empty()) {
+		root = std::move(value);
+		return;
+	}
+	Frame& top = stack.back();
+	if (top.map) top.map->insert_or_assign(std::move(top.key), std::move(value));
+	else top.list->append(std::move(value));
+}
+
+// Numbers and booleans go into lists unboxed for as long as the list holds nothing else.
+void PushParser::attachNumber(double value) {
+	if (!stack.empty() && stack.back().list) stack.back().list->appendNumber(value);
+	else attach(makeNode<JsonDouble>(resource, value));
+}
+
+void PushParser::attachBool(bool value) {
+	if (!stack.empty() && stack.back().list) stack.back().list->appendBool(value);
+	else attach(makeNode<JsonBool>(resource, value));
+}
+
+bool PushParser::fail(JsonParseErrors id, const char* what, const char* data, size_t at) {
+	size_t error_line = line, error_column = column;
+	for (size_t i = 0; i < at; ++i) {
+		if (data[i] == '\n') { ++error_line; error_column = 1; }
+		else ++error_column;
+	}
+	parse_error = ParseError(id, what, static_cast<int>(error_line), static_cast<int>(error_column));
+	has_failed = true;
+	return false;
+}
+
+void PushParser::advance(const char* data, size_t size) {
+	const char* last_newline = nullptr;
+	for (const char* p = data; (p = static_cast<const char*>(std::memchr(p, '\n', data + size - p))) != nullptr; ++p) {
+		++line;
+		last_newline = p;
+	}
+	if (last_newline) column = 1 + (data + size - last_newline - 1);
+	else column += size;
+}
+
+void PushParser::reset() {
+	root.reset();
+	stack.clear();
+	expect = EXPECT_VALUE;
+	token = TOKEN_NONE;
+	token_text.clear();
+	decoded = JsonStringData(resource);
+	pending.clear();
+	string_too_long = false;
+	number_state = NUMBER_START;
+	literal = nullptr;
+	literal_matched = 0;
+	bytes_fed = 0;
+	elements = 0;
+	line = 1;
+	column = 1;
+	has_failed = false;
+	parse_error = ParseError();
+	parse_ns = 0;
+}
+
+Projection::Projection(std::initializer_list<std::string_view> paths) {
+	nodes.emplace_back();
+	for (std::string_view path : paths) add(path);
+}
+
+Projection::Projection(const std::vector<std::string>& paths) {
+	nodes.emplace_back();
+	for (const std::string& path : paths) add(path);
+}
+
+void Projection::add(std::string_view path) {
+	size_t current = 0;
+	while (true) {
+		size_t dot = path.find('.');
+		std::string_view segment = path.substr(0, dot);
+		if (segment.empty()) throw std::invalid_argument("projection: empty key in path");
+		// A shorter path already selects the whole subtree.
+		if (nodes[current].whole) return;
+		auto child = nodes[current].children.find(segment);
+		if (child == nodes[current].children.end()) {
+			size_t index = nodes.size();
+			nodes.emplace_back();
+			child = nodes[current].children.emplace(std::string(segment), index).first;
+		}
+		current = child->second;
+		if (dot == std::string_view::npos) break;
+		path.remove_prefix(dot + 1);
+	}
+	nodes[current].whole = true;
+	nodes[current].children.clear();
+}
+
+static unsigned schema_type(const JsonValue& name) {
+	static const std::pair<const char*, unsigned> names[] = {
+		{ "null", SCHEMA_NULL }, { "boolean", SCHEMA_BOOLEAN }, { "integer", SCHEMA_INTEGER }, { "number", SCHEMA_NUMBER },
+		{ "string", SCHEMA_STRING }, { "array", SCHEMA_ARRAY }, { "object", SCHEMA_OBJECT }
+	};
+	if (name.type() == JSON_STRING) {
+		for (auto& [type_name, bit] : names) {
+			if (*name.getStringPtr() == type_name) return bit;
+		}
+	}
+	throw std::invalid_argument("schema: unknown type");
+}
+
+static const JsonValue& schema_value(const std::shared_ptr<JsonValue>& value, const JsonStringData& keyword) {
+	if (!value) throw std::invalid_argument("schema: missing value for " + std::string(keyword));
+	return *value;
+}
+
+static double schema_number(const JsonValue& value, const JsonStringData& keyword) {
+	if (value.type() != JSON_DOUBLE) throw std::invalid_argument("schema: " + std::string(keyword) + " must be a number");
+	return value.getDouble();
+}
+
+static size_t schema_count(const JsonValue& value, const JsonStringData& keyword) {
+	double number = schema_number(value, keyword);
+	if (number < 0 || number != std::floor(number)) throw std::invalid_argument("schema: " + std::string(keyword) + " must be a non-negative integer");
+	return static_cast<size_t>(number);
+}
+
+Schema::Schema(const Json& schema) {
+	compile(*schema.document());
+}
+
+size_t Schema::compile(const JsonValue& schema) {
+	size_t index = nodes.size();
+	nodes.emplace_back();
+	if (schema.type() == JSON_BOOL) {
+		if (!schema.getBool()) nodes[index].types = 0;
+		return index;
+	}
+	if (schema.type() != JSON_MAP) throw std::invalid_argument("schema: a schema must be an object or a boolean");
+
+	// Children are appended to nodes while compiling, so the node is filled locally and stored at the end.
+	Node node;
+	for (auto& [keyword, value_ptr] : schema.getMap()) {
+		const JsonValue& value = schema_value(value_ptr, keyword);
+		if (keyword == "type") {
+			if (value.type() == JSON_VECTOR) {
+				node.types = 0;
+				for (auto& name : value.getList()) node.types |= schema_type(schema_value(name, keyword));
+			}
+			else node.types = schema_type(value);
+		}
+		else if (keyword == "enum") {
+			if (value.type() != JSON_VECTOR) throw std::invalid_argument("schema: enum must be a list");
+			node.has_enum = true;
+			for (auto& option : value.getList()) {
+				const JsonValue& entry = schema_value(option, keyword);
+				switch (entry.type()) {
+				case JSON_NULL:		node.enum_null = true; break;
+				case JSON_BOOL:		(entry.getBool() ? node.enum_true : node.enum_false) = true; break;
+				case JSON_DOUBLE:	node.enum_numbers.push_back(entry.getDouble()); break;
+				case JSON_STRING:	node.enum_strings.emplace_back(*entry.getStringPtr()); break;
+				default: throw std::invalid_argument("schema: enum supports scalar values only");
+				}
+			}
+		}
+		else if (keyword == "minimum")			node.minimum = schema_number(value, keyword);
+		else if (keyword == "maximum")			node.maximum = schema_number(value, keyword);
+		else if (keyword == "exclusiveMinimum")	node.exclusive_minimum = schema_number(value, keyword);
+		else if (keyword == "exclusiveMaximum")	node.exclusive_maximum = schema_number(value, keyword);
+		else if (keyword == "minLength")		node.min_length = schema_count(value, keyword);
+		else if (keyword == "maxLength")		node.max_length = schema_count(value, keyword);
+		else if (keyword == "minItems")			node.min_items = schema_count(value, keyword);
+		else if (keyword == "maxItems")			node.max_items = schema_count(value, keyword);
+		else if (keyword == "items")			node.items = compile(value);
+		else if (keyword == "properties") {
+			if (value.type() != JSON_MAP) throw std::invalid_argument("schema: properties must be an object");
+			for (auto& [name, property] : value.getMap()) {
+				node.properties[std::string(name)] = Property{ compile(schema_value(property, name)) };
+			}
+		}
+		else if (keyword == "required") {
+			if (value.type() != JSON_VECTOR) throw std::invalid_argument("schema: required must be a list");
+			for (auto& name : value.getList()) {
+				const JsonValue& entry = schema_value(name, keyword);
+				if (entry.type() != JSON_STRING) throw std::invalid_argument("schema: required must list strings");
+				node.required.emplace_back(*entry.getStringPtr());
+			}
+		}
+		else if (keyword == "additionalProperties") {
+			if (value.type() == JSON_BOOL) node.additional_allowed = value.getBool();
+			else node.additional = compile(value);
+		}
+		else if (keyword == "ignore") {
+			if (value.type() != JSON_BOOL) throw std::invalid_argument("schema: ignore must be a boolean");
+			node.ignore = value.getBool();
+		}
+	}
+
+	// Every required key gets a property, unconstrained if the schema does not describe it, carrying its slot.
+	std::vector<std::string> required;
+	for (auto& name : node.required) {
+		auto property = node.properties.find(name);
+		if (property == node.properties.end()) {
+			size_t any = nodes.size();
+			nodes.emplace_back();
+			property = node.properties.emplace(name, Property{ any }).first;
+		}
+		if (property->second.required_slot != npos) continue;
+		property->second.required_slot = required.size();
+		required.push_back(name);
+	}
+	node.required = std::move(required);
+
+	nodes[index] = std::move(node);
+	return index;
+}
+
+std::string Json::stringDump() const {
+	const JsonValue& value = *document();
+	SMPJ_STATS(StatsScope stats_scope(OP_DUMP));
+	SMPJ_STATS(stats_scope.begin());
+	JsonWriter writer;
+	value.writeTo(writer, 0);
+	SMPJ_STATS(stats_scope.end(PHASE_DUMP));
+	SMPJ_STATS(stats_scope.stats.output_bytes = writer.buffer.size());
+	SMPJ_STATS(stats_scope.stats.estimated_bytes = writer.buffer.capacity());
+	SMPJ_STATS(stats_scope.stats.result = JSON_OK);
+	return std::move(writer.buffer);
+}
+
+void Json::writeToFile(std::fstream& file_stream, const std::string& path) const {
+	const JsonValue& value = *document();
+	SMPJ_STATS(StatsScope stats_scope(OP_WRITE));
 	file_stream.open(path, std::ios::out | std::ios::binary);
 	if (!file_stream.is_open()) throw std::runtime_error("could not open filestream at " + path + "\n");
-	std::string contents = stringDump();
+	SMPJ_STATS(stats_scope.begin());
+	JsonWriter writer;
+	value.writeTo(writer, 0);
+	std::string& contents = writer.buffer;
+	SMPJ_STATS(stats_scope.end(PHASE_DUMP));
+	SMPJ_STATS(stats_scope.begin());
 	file_stream.write(contents.data(), contents.size());
 	file_stream.close();
+	SMPJ_STATS(stats_scope.end(PHASE_WRITE));
+	SMPJ_STATS(stats_scope.stats.output_bytes = contents.size());
+	SMPJ_STATS(stats_scope.stats.estimated_bytes = contents.capacity());
+	SMPJ_STATS(stats_scope.stats.result = JSON_OK);
+}
+
+// Temporary file in the directory of the target, renamed over it by commit(). Until then the target is
+// untouched, and a file that is never committed is removed again. A symbolic link is resolved first, so
+// the file it points to is replaced rather than the link.
+class AtomicFile {
+public:
+	explicit AtomicFile(const std::string& path) : path(resolveLink(path)) {
+		static std::atomic<unsigned> counter{ 0 };
+#ifdef _WIN32
+		temp_path = path + ".tmp." + std::to_string(_getpid()) + "." + std::to_string(counter++);
+		handle = CreateFileA(temp_path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) fail("could not create");
+#else
+		temp_path = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(counter++);
+		descriptor = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+		if (descriptor < 0) fail("could not create");
+		try { matchTarget(); }
+		catch (...) {
+			close();
+			std::remove(temp_path.c_str());
+			throw;
+		}
+#endif
+	}
+	AtomicFile(const AtomicFile&) = delete;
+	AtomicFile& operator=(const AtomicFile&) = delete;
+	~AtomicFile() {
+		if (committed) return;
+		close();
+		std::remove(temp_path.c_str());
+	}
+
+	void write(std::string_view data) {
+		while (!data.empty()) {
+#ifdef _WIN32
+			DWORD written = 0;
+			DWORD request = static_cast<DWORD>(std::min<size_t>(data.size(), 1u << 30));
+			if (!WriteFile(handle, data.data(), request, &written, nullptr)) fail("could not write");
+#else
+			ssize_t written = ::write(descriptor, data.data(), data.size());
+			if (written < 0) {
+				if (errno == EINTR) continue;
+				fail("could not write");
+			}
+#endif
+			data.remove_prefix(static_cast<size_t>(written));
+		}
+	}
+
+	// Flushes the contents to disk, then renames; on POSIX the directory is synced too so the rename
+	// itself survives a crash.
+	void commit() {
+#ifdef _WIN32
+		if (!FlushFileBuffers(handle)) fail("could not flush");
+		close();
+		if (!MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) fail("could not rename");
+#else
+		if (::fsync(descriptor) != 0) fail("could not sync");
+		if (::close(descriptor) != 0) { descriptor = -1; fail("could not close"); }
+		descriptor = -1;
+		if (std::rename(temp_path.c_str(), path.c_str()) != 0) fail("could not rename");
+		size_t slash = path.find_last_of('/');
+		std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+		int directory_descriptor = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+		if (directory_descriptor >= 0) {
+			::fsync(directory_descriptor);
+			::close(directory_descriptor);
+		}
+#endif
+		committed = true;
+	}
+
+private:
+	// The final target of path if it is a link to an existing file, path itself otherwise.
+	static std::string resolveLink(const std::string& path) {
+#ifdef _WIN32
+		DWORD attributes = GetFileAttributesA(path.c_str());
+		if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_REPARSE_POINT)) return path;
+		HANDLE target = CreateFileA(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (target == INVALID_HANDLE_VALUE) return path;
+		char resolved[MAX_PATH];
+		DWORD length = GetFinalPathNameByHandleA(target, resolved, MAX_PATH, FILE_NAME_NORMALIZED);
+		CloseHandle(target);
+		return length > 0 && length < MAX_PATH ? std::string(resolved, length) : path;
+#else
+		struct stat link;
+		if (::lstat(path.c_str(), &link) != 0 || !S_ISLNK(link.st_mode)) return path;
+		char* resolved = ::realpath(path.c_str(), nullptr);
+		if (resolved == nullptr) return path;
+		std::string target = resolved;
+		std::free(resolved);
+		return target;
+#endif
+	}
+	[[noreturn]] void fail(const char* what) {
+#ifdef _WIN32
+		std::string reason = "error " + std::to_string(GetLastError());
+#else
+		std::string reason = std::strerror(errno);
+#endif
+		throw std::runtime_error(std::string(what) + " " + temp_path + " for " + path + ": " + reason);
+	}
+#ifndef _WIN32
+	// A new file gets 0666 less the umask from open; replacing a file keeps its mode and, where we are
+	// allowed to, its owner. chown may clear setuid bits, so the mode is applied after it.
+	void matchTarget() {
+		struct stat target;
+		if (::stat(path.c_str(), &target) != 0) return;
+		if (::fchown(descriptor, target.st_uid, target.st_gid) != 0 && errno != EPERM) fail("could not chown");
+		if (::fchmod(descriptor, target.st_mode & 07777) != 0) fail("could not chmod");
+	}
+#endif
+	void close() {
+#ifdef _WIN32
+		if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+		handle = INVALID_HANDLE_VALUE;
+#else
+		if (descriptor >= 0) ::close(descriptor);
+		descriptor = -1;
+#endif
+	}
+
+	std::string path;
+	std::string temp_path;
+#ifdef _WIN32
+	HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+	int descriptor = -1;
+#endif
+	bool committed = false;
+};
+
+static const size_t save_chunk_size = 1 << 20;
+
+static WriteResult save_document(const std::shared_ptr<JsonValue>& root, const std::string& path) {
+	using clock = std::chrono::steady_clock;
+	auto elapsed = [](clock::time_point since) {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - since).count());
+	};
+	SMPJ_STATS(StatsScope stats_scope(OP_WRITE));
+	WriteResult result;
+	clock::time_point start = clock::now();
+
+	AtomicFile file(path);
+	JsonWriter writer;
+	// No reserve: a small document only allocates what it needs, a large one grows the buffer to about a chunk.
+	writer.chunk_size = save_chunk_size;
+	writer.sink = [&](std::string_view chunk) {
+		clock::time_point write_start = clock::now();
+		file.write(chunk);
+		result.write_ns += elapsed(write_start);
+		result.bytes_written += chunk.size();
+	};
+	root->writeTo(writer, 0);
+	writer.flush();
+
+	clock::time_point sync_start = clock::now();
+	file.commit();
+	result.sync_ns = elapsed(sync_start);
+	result.total_ns = elapsed(start);
+	result.serialize_ns = result.total_ns - result.write_ns - result.sync_ns;
+	SMPJ_STATS(stats_scope.stats.phase_ns[PHASE_DUMP] = result.serialize_ns);
+	SMPJ_STATS(stats_scope.stats.phase_ns[PHASE_WRITE] = result.write_ns + result.sync_ns);
+	SMPJ_STATS(stats_scope.stats.output_bytes = result.bytes_written);
+	SMPJ_STATS(stats_scope.stats.estimated_bytes = writer.buffer.capacity());
+	SMPJ_STATS(stats_scope.stats.result = JSON_OK);
+	return result;
+}
+
+WriteResult Json::saveToFile(const std::string& path) const {
+	return save_document(document(), path);
+}
+
+// The snapshot lives on new_delete_resource: the document's own resource need not be thread safe and
+// may be gone before the save finishes.
+std::future<WriteResult> Json::saveToFileAsync(const std::string& path) const {
+	std::shared_ptr<JsonValue> snapshot = document()->clone(std::pmr::new_delete_resource());
+	return std::async(std::launch::async, [snapshot = std::move(snapshot), path]() { return save_document(snapshot, path); });
+}
+
+const std::shared_ptr<JsonValue>& Json::document() const {
+	if (!root) throw std::runtime_error(parse_failed ? "Json holds no document: its input failed to parse" : "use of a moved-from Json");
+	return root;
 }
 
 std::shared_ptr<JsonValue>& Json::operator[] (const std::string& key) {
-	if (root->type() != JSON_MAP) throw std::runtime_error("invalid operator usage for JsonMap top level object, use strings only");
-	return (*root->getMapPtr())[key];
+	if (document()->type() != JSON_MAP) throw std::runtime_error("invalid operator usage for JsonMap top level object, use strings only");
+	return (*root)[key];
 }
 const std::shared_ptr<JsonValue>& Json::operator[] (const std::string& key) const {
-	if (root->type() != JSON_MAP) throw std::runtime_error("invalid operator usage for JsonMap top level object, use strings only");
+	if (document()->type() != JSON_MAP) throw std::runtime_error("invalid operator usage for JsonMap top level object, use strings only");
 	auto& map = *root->getMapPtr();
-	auto it = map.find(key);
+	auto it = map.find(lookup_key(key));
 	if (it == map.end()) throw std::out_of_range("Key not found in JSON object");
 	return it->second;
 }
 std::shared_ptr<JsonValue>& Json::operator[] (size_t index) {
-	if (root->type() != JSON_VECTOR) throw std::runtime_error("invalid operator usage for JsonList top level object, use integers only");
+	if (document()->type() != JSON_VECTOR) throw std::runtime_error("invalid operator usage for JsonList top level object, use integers only");
 	return (*root->getListPtr())[index];
 }
 const std::shared_ptr<JsonValue>& Json::operator[] (size_t index) const {
-	if (root->type() != JSON_VECTOR) throw std::runtime_error("invalid operator usage for JsonList top level object, use integers only");
-	auto& list = *root->getListPtr();
-	if (index > list.size()) throw std::out_of_range("Index out of range");
+	if (document()->type() != JSON_VECTOR) throw std::runtime_error("invalid operator usage for JsonList top level object, use integers only");
+	const JsonListData& list = root->getList();
+	if (index >= list.size()) throw std::out_of_range("Index out of range");
 	return list[index];
 }
 
+JsonMap& Json::rootMap() {
+	if (document()->type() != JSON_MAP) throw std::runtime_error("invalid operator usage for JsonMap top level object, use strings only");
+	return static_cast<JsonMap&>(*root);
+}
+
+JsonList& Json::rootList() {
+	if (document()->type() != JSON_VECTOR) throw std::runtime_error("invalid operator usage for JsonList top level object, use integers only");
+	return static_cast<JsonList&>(*root);
+}
+
+void Json::reserve(size_t count) {
+	if (document()->type() == JSON_MAP) rootMap().reserve(count);
+	else rootList().reserve(count);
+}
+
 std::shared_ptr<JsonValue>& JsonList::operator[](size_t index) {
+	JsonListData& value = boxed();
 	if (index >= value.size()) throw std::runtime_error("index is out of bounds");
 	return value[index];
 }
 const std::shared_ptr<JsonValue>& JsonList::operator[](size_t index) const {
+	const JsonListData& value = getList();
 	if (index >= value.size()) throw std::runtime_error("index is out of bounds");
 	return value[index];
 }
+
+static void box_elements(const JsonList& list, JsonListData& out, std::pmr::memory_resource* resource) {
+	out.reserve(list.size());
+	if (const JsonNumberData* numbers = list.getNumbers()) {
+		for (double number : *numbers) out.push_back(makeNode<JsonDouble>(resource, number));
+	}
+	else if (const JsonBoolData* bools = list.getBools()) {
+		for (bool flag : *bools) out.push_back(makeNode<JsonBool>(resource, flag));
+	}
+}
+
+JsonListData& JsonList::boxed() const {
+	if (storage() == LIST_BOXED) return std::get<LIST_BOXED>(items);
+	dropView();
+	std::pmr::memory_resource* resource = memoryResource();
+	JsonListData value(resource);
+	box_elements(*this, value, resource);
+	return items.emplace<LIST_BOXED>(std::move(value));
+}
+
+// Readers that race to build the view each build one; the first to publish it wins.
+const JsonListData& JsonList::view() const {
+	if (JsonListData* existing = boxed_view.load(std::memory_order_acquire)) return *existing;
+	auto built = std::make_unique<JsonListData>(std::pmr::new_delete_resource());
+	box_elements(*this, *built, std::pmr::new_delete_resource());
+	JsonListData* expected = nullptr;
+	if (boxed_view.compare_exchange_strong(expected, built.get(), std::memory_order_acq_rel)) return *built.release();
+	return *expected;
+}
+
+void JsonList::appendNumber(double value) {
+	if (storage() == LIST_BOXED && std::get<LIST_BOXED>(items).empty()) {
+		size_t capacity = std::get<LIST_BOXED>(items).capacity();
+		items.emplace<LIST_NUMBERS>(memoryResource()).reserve(capacity);
+	}
+	dropView();
+	if (JsonNumberData* numbers = std::get_if<LIST_NUMBERS>(&items)) numbers->push_back(value);
+	else boxed().push_back(makeNode<JsonDouble>(memoryResource(), value));
+}
+
+void JsonList::appendBool(bool value) {
+	if (storage() == LIST_BOXED && std::get<LIST_BOXED>(items).empty()) {
+		size_t capacity = std::get<LIST_BOXED>(items).capacity();
+		items.emplace<LIST_BOOLS>(memoryResource()).reserve(capacity);
+	}
+	dropView();
+	if (JsonBoolData* bools = std::get_if<LIST_BOOLS>(&items)) bools->push_back(value);
+	else boxed().push_back(makeNode<JsonBool>(memoryResource(), value));
+}
+
+void JsonList::append(std::shared_ptr<JsonValue> value) {
+	boxed().push_back(std::move(value));
+}
+
+bool JsonList::pack() {
+	if (storage() != LIST_BOXED) return true;
+	const JsonListData& value = std::get<LIST_BOXED>(items);
+	if (value.empty() || !value.front()) return false;
+	JsonType kind = value.front()->type();
+	if (kind != JSON_DOUBLE && kind != JSON_BOOL) return false;
+	for (auto& element : value) {
+		if (!element || element->type() != kind) return false;
+	}
+	std::pmr::memory_resource* resource = memoryResource();
+	if (kind == JSON_DOUBLE) {
+		JsonNumberData numbers(resource);
+		numbers.reserve(value.size());
+		for (auto& element : value) numbers.push_back(element->getDouble());
+		items.emplace<LIST_NUMBERS>(std::move(numbers));
+	}
+	else {
+		JsonBoolData bools(resource);
+		bools.reserve(value.size());
+		for (auto& element : value) bools.push_back(element->getBool());
+		items.emplace<LIST_BOOLS>(std::move(bools));
+	}
+	return true;
+}
 std::shared_ptr<JsonValue>& JsonMap::operator[] (const std::string& key) {
-	return value[key];
+	auto it = value.find(lookup_key(key));
+	if (it != value.end()) return it->second;
+	return value.try_emplace(JsonStringData(key, value.get_allocator().resource())).first->second;
 }
 const std::shared_ptr<JsonValue>& JsonMap::operator[] (const std::string& key) const {
-	auto it = value.find(key);
+	auto it = value.find(lookup_key(key));
 	if (it == value.end()) throw std::out_of_range("Key not found in JSON object");
 	return it->second;
 }
 
-std::string JsonList::asString(int offset) const {
-	std::string output = "[";
+static void append_double(std::string& output, double value) {
+	std::string number = std::to_string(value);
+	auto last_valid = number.find_last_not_of('0') + 1;
+	if (last_valid != std::string::npos) {
+		number.erase(number.begin() + last_valid, number.end());
+		if (number.back() == '.') number.pop_back();
+	}
+	output += number;
+}
+
+// Unboxed lists hold only primitives and are written on one line like boxed ones.
+template<typename Data, typename Write>
+static void write_packed(JsonWriter& writer, const Data& data, Write write) {
+	std::string& output = writer.buffer;
+	output += '[';
+	if (!data.empty()) {
+		output += ' ';
+		for (size_t i = 0; i < data.size(); ++i) {
+			write(output, data[i]);
+			if (i + 1 < data.size()) output += ',';
+			output += ' ';
+			writer.flushIfFull();
+		}
+	}
+	output += ']';
+}
+
+void JsonList::writeTo(JsonWriter& writer, int offset) const {
+	if (const JsonNumberData* numbers = getNumbers()) {
+		write_packed(writer, *numbers, append_double);
+		return;
+	}
+	if (const JsonBoolData* bools = getBools()) {
+		write_packed(writer, *bools, [](std::string& output, bool flag) { output += flag ? "true" : "false"; });
+		return;
+	}
+	const JsonListData& value = std::get<LIST_BOXED>(items);
+	std::string& output = writer.buffer;
+	output += '[';
 	bool contains_primitives = true;
-	char delimiter;
-	std::string indent;
 	for (auto& val : value) {
 		if (val->type() == JSON_MAP || val->type() == JSON_VECTOR) {
 			contains_primitives = false;
 			break;
 		}
 	}
-	if (contains_primitives) {
-		delimiter = ' ';
-		indent = "";
-	} 
-	else {
-		delimiter = '\n';
-		indent = std::string((offset + 1) * 4, ' ');
-	}
+	char delimiter = contains_primitives ? ' ' : '\n';
+	size_t indent = contains_primitives ? 0 : (offset + 1) * 4;
 	if (!value.empty()) {
 		output += delimiter;
 		for (size_t i = 0; i < value.size(); ++i) {
-			output += indent + value[i]->asString(offset + 1);
-			if (i + 1 < value.size()) output += ",";
+			output.append(indent, ' ');
+			value[i]->writeTo(writer, offset + 1);
+			if (i + 1 < value.size()) output += ',';
 			output += delimiter;
+			writer.flushIfFull();
 		}
-		if(!contains_primitives) output += std::string(offset * 4, ' ');
+		if (!contains_primitives) output.append(offset * 4, ' ');
 	}
-	output += "]";
-	return output;
+	output += ']';
 }
 
-std::string JsonMap::asString(int offset) const {
-	std::string output = "{";
+void JsonMap::writeTo(JsonWriter& writer, int offset) const {
+	std::string& output = writer.buffer;
+	output += '{';
 	if (!value.empty()) {
-		output += "\n";
-		std::string indent((offset + 1) * 4, ' ');
+		output += '\n';
+		size_t indent = (offset + 1) * 4;
 
 		size_t count = 0;
 		for (auto& [key, val] : value) {
-			output += indent + "\"" + key + "\" : " + val->asString(offset + 1);
-			if (++count < value.size()) output += ",";
-			output += "\n";
+			output.append(indent, ' ');
+			output += '"';
+			append_escaped(output, key);
+			output += "\" : ";
+			val->writeTo(writer, offset + 1);
+			if (++count < value.size()) output += ',';
+			output += '\n';
+			writer.flushIfFull();
 		}
-		output += std::string(offset * 4, ' ');
+		output.append(offset * 4, ' ');
 	}
-	output += "}";
-	return output;
+	output += '}';
 }
 
-std::string JsonDouble::asString(int offset) const {
-	std::string output = std::to_string(value);
-	auto last_valid = output.find_last_not_of('0') + 1;
-	if (last_valid != std::string::npos) {
-		output.erase(output.begin() + last_valid , output.end());
-		if (output.back() == '.') output.pop_back();
-	}
-	return output;
+void JsonDouble::writeTo(JsonWriter& writer, int offset) const {
+	append_double(writer.buffer, value);
 }
 
-std::string JsonString::asString(int offset) const {
-	std::string output = "\"";
-	for (char current : value) {
-		switch (current) {
-		case '\b': output += "\\b"; break;
-		case '\f': output += "\\f"; break;
-		case '\n': output += "\\n"; break;
-		case '\r': output += "\\r"; break;
-		case '\t': output += "\\t"; break;
-		case '"':  output += "\\\""; break;
-		case '\\': output += "\\\\"; break;
-		case '/':  output += "\\/"; break;
-		default:   output += current;
-		}
-	}
-	output += "\"";
-	return output;
+void JsonString::writeTo(JsonWriter& writer, int offset) const {
+	std::string& output = writer.buffer;
+	output += '"';
+	append_escaped(output, value);
+	output += '"';
 }
 
-std::shared_ptr<JsonValue> JsonList::clone() const {
-	auto copy = std::make_shared<JsonList>();
+std::shared_ptr<JsonValue> JsonList::clone(std::pmr::memory_resource* resource) const {
+	if (resource == nullptr) resource = memoryResource();
+	auto copy = makeNode<JsonList>(resource);
+	if (const JsonNumberData* numbers = getNumbers()) {
+		copy->assignNumbers(numbers->begin(), numbers->end());
+		return copy;
+	}
+	if (const JsonBoolData* bools = getBools()) {
+		copy->assignBools(bools->begin(), bools->end());
+		return copy;
+	}
+	const JsonListData& value = std::get<LIST_BOXED>(items);
+	JsonListData& elements = std::get<LIST_BOXED>(copy->items);
+	elements.reserve(value.size());
 	for (auto& element : value) {
-		copy->value.push_back(element->clone());
+		elements.push_back(element->clone(resource));
 	}
 	return copy;
 }
 
-std::shared_ptr<JsonValue> JsonMap::clone() const {
-	auto copy = std::make_shared<JsonMap>();
+std::shared_ptr<JsonValue> JsonMap::clone(std::pmr::memory_resource* resource) const {
+	if (resource == nullptr) resource = value.get_allocator().resource();
+	auto copy = makeNode<JsonMap>(resource);
+	copy->value.reserve(value.size());
 	for (auto& [key, val] : value) {
-		copy->value.emplace(key, val->clone());
+		copy->value.emplace(key, val->clone(resource));
 	}
 	return copy;
-}
\ No newline at end of file
+}
+std::shared_ptr<const FrozenJson> Json::freeze() const {
+	return std::make_shared<const FrozenJson>(*document());
+}
+
+static void count_frozen(const JsonValue* value, size_t& node_count, size_t& key_count, size_t& char_count) {
+	if (value == nullptr) return;
+	switch (value->type()) {
+	case JSON_STRING:
+		char_count += value->getStringPtr()->size();
+		break;
+	case JSON_VECTOR:
+		if (const JsonNumberData* numbers = value->getNumbers()) { node_count += numbers->size(); break; }
+		if (const JsonBoolData* bools = value->getBools()) { node_count += bools->size(); break; }
+		node_count += value->getList().size();
+		for (auto& element : value->getList()) count_frozen(element.get(), node_count, key_count, char_count);
+		break;
+	case JSON_MAP:
+		node_count += value->getMap().size();
+		key_count += value->getMap().size();
+		for (auto& [key, val] : value->getMap()) {
+			char_count += key.size();
+			count_frozen(val.get(), node_count, key_count, char_count);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static uint32_t frozen_key_hash(std::string_view key) {
+	return static_cast<uint32_t>(std::hash<std::string_view>()(key));
+}
+
+static size_t frozen_bucket(uint32_t hash, size_t bucket_count) {
+	return static_cast<size_t>((static_cast<uint64_t>(hash) * bucket_count) >> 32);
+}
+
+FrozenJson::FrozenJson(const JsonValue& root) {
+	size_t node_count = 1, key_count = 0, char_count = 0;
+	count_frozen(&root, node_count, key_count, char_count);
+	if (node_count > UINT32_MAX || key_count > UINT32_MAX) throw std::length_error("document too large to freeze");
+	nodes.reserve(node_count);
+	keys.reserve(key_count);
+	buckets.reserve(key_count);
+	chars.reserve(char_count);
+	nodes.resize(1);
+	store(root, 0);
+}
+
+uint64_t FrozenJson::storeChars(std::string_view text) {
+	uint64_t offset = chars.size();
+	chars.insert(chars.end(), text.begin(), text.end());
+	return offset;
+}
+
+// The children of a container are stored as one block at the end of nodes, and the keys of a map as
+// one block at the end of keys, entry i of the map being keys[children.keys + i] and nodes[children.values + i].
+void FrozenJson::store(const JsonValue& value, size_t index) {
+	FrozenValue::Node node{};
+	node.type = value.type();
+	switch (node.type) {
+	case JSON_BOOL:
+		node.boolean = value.getBool();
+		break;
+	case JSON_DOUBLE:
+		node.number = value.getDouble();
+		break;
+	case JSON_STRING: {
+		const JsonStringData& text = *value.getStringPtr();
+		if (text.size() > UINT32_MAX) throw std::length_error("string too long to freeze");
+		node.size = static_cast<uint32_t>(text.size());
+		node.offset = storeChars(text);
+		break;
+	}
+	case JSON_VECTOR: {
+		size_t first = nodes.size();
+		node.children.values = static_cast<uint32_t>(first);
+		if (const JsonNumberData* numbers = value.getNumbers()) {
+			node.size = static_cast<uint32_t>(numbers->size());
+			nodes.resize(first + numbers->size());
+			for (size_t i = 0; i < numbers->size(); ++i) {
+				nodes[first + i].type = JSON_DOUBLE;
+				nodes[first + i].number = (*numbers)[i];
+			}
+			break;
+		}
+		if (const JsonBoolData* bools = value.getBools()) {
+			node.size = static_cast<uint32_t>(bools->size());
+			nodes.resize(first + bools->size());
+			for (size_t i = 0; i < bools->size(); ++i) {
+				nodes[first + i].type = JSON_BOOL;
+				nodes[first + i].boolean = (*bools)[i];
+			}
+			break;
+		}
+		const JsonListData& list = value.getList();
+		node.size = static_cast<uint32_t>(list.size());
+		nodes.resize(first + list.size());
+		for (size_t i = 0; i < list.size(); ++i) {
+			if (list[i]) store(*list[i], first + i);
+			else nodes[first + i].type = JSON_NULL;
+		}
+		break;
+	}
+	case JSON_MAP: {
+		const JsonMapData& map = value.getMap();
+		std::vector<std::pair<uint32_t, const JsonMapData::value_type*>> entries;
+		entries.reserve(map.size());
+		for (auto& entry : map) entries.emplace_back(frozen_key_hash(entry.first), &entry);
+		std::sort(entries.begin(), entries.end(), [](const auto& left, const auto& right) {
+			return left.first != right.first ? left.first < right.first : left.second->first < right.second->first;
+		});
+
+		size_t first = nodes.size();
+		size_t first_key = keys.size();
+		node.size = static_cast<uint32_t>(map.size());
+		node.children.values = static_cast<uint32_t>(first);
+		node.children.keys = static_cast<uint32_t>(first_key);
+		nodes.resize(first + map.size());
+		keys.resize(first_key + map.size());
+		buckets.resize(first_key + map.size());
+		for (size_t bucket = 0, i = 0; bucket < entries.size(); ++bucket) {
+			while (i < entries.size() && frozen_bucket(entries[i].first, entries.size()) < bucket) ++i;
+			buckets[first_key + bucket] = static_cast<uint32_t>(i);
+		}
+		for (size_t i = 0; i < entries.size(); ++i) {
+			auto& [hash, entry] = entries[i];
+			if (entry->first.size() > UINT32_MAX) throw std::length_error("key too long to freeze");
+			keys[first_key + i] = FrozenValue::Key{ hash, static_cast<uint32_t>(entry->first.size()), storeChars(entry->first) };
+			if (entry->second) store(*entry->second, first + i);
+			else nodes[first + i].type = JSON_NULL;
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	nodes[index] = node;
+}
+
+const FrozenValue::Node* FrozenValue::child(size_t index) const {
+	return &document->nodes[node->children.values + index];
+}
+
+const FrozenValue::Key* FrozenValue::key(size_t index) const {
+	return &document->keys[node->children.keys + index];
+}
+
+std::string_view FrozenValue::chars(uint64_t offset, size_t size) const {
+	return std::string_view(document->chars.data() + offset, size);
+}
+
+double FrozenValue::getDouble() const {
+	if (type() != JSON_DOUBLE) throw std::bad_cast();
+	return node->number;
+}
+
+bool FrozenValue::getBool() const {
+	if (type() != JSON_BOOL) throw std::bad_cast();
+	return node->boolean;
+}
+
+std::string_view FrozenValue::getString() const {
+	if (type() != JSON_STRING) throw std::bad_cast();
+	return chars(node->offset, node->size);
+}
+
+size_t FrozenValue::size() const {
+	if (type() != JSON_VECTOR && type() != JSON_MAP) return 0;
+	return node->size;
+}
+
+FrozenValue FrozenValue::operator[] (size_t index) const {
+	if (type() != JSON_VECTOR) throw std::runtime_error("invalid operator usage for frozen value, use integers on lists only");
+	if (index >= node->size) throw std::out_of_range("Index out of range");
+	return FrozenValue(child(index), document);
+}
+
+FrozenValue FrozenValue::operator[] (std::string_view key) const {
+	FrozenValue found = find(key);
+	if (!found) throw std::out_of_range("Key not found in JSON object");
+	return found;
+}
+
+FrozenValue FrozenValue::find(std::string_view name) const {
+	if (type() != JSON_MAP) throw std::runtime_error("invalid operator usage for frozen value, use strings on maps only");
+	if (node->size == 0) return FrozenValue();
+	uint32_t hash = frozen_key_hash(name);
+	size_t bucket = frozen_bucket(hash, node->size);
+	const uint32_t* directory = &document->buckets[node->children.keys];
+	size_t end = bucket + 1 < node->size ? directory[bucket + 1] : node->size;
+	for (size_t i = directory[bucket]; i < end; ++i) {
+		const Key* entry = key(i);
+		if (entry->hash == hash && chars(entry->offset, entry->size) == name) return FrozenValue(child(i), document);
+	}
+	return FrozenValue();
+}
+
+std::string_view FrozenValue::keyAt(size_t index) const {
+	if (type() != JSON_MAP) throw std::bad_cast();
+	if (index >= node->size) throw std::out_of_range("Index out of range");
+	return chars(key(index)->offset, key(index)->size);
+}
+
+FrozenValue FrozenValue::valueAt(size_t index) const {
+	if (type() != JSON_MAP) throw std::bad_cast();
+	if (index >= node->size) throw std::out_of_range("Index out of range");
+	return FrozenValue(child(index), document);
+}
+
+std::string FrozenValue::stringDump() const {
+	std::string output;
+	writeTo(output, 0);
+	return output;
+}
+
+// Same layout as JsonValue::writeTo.
+void FrozenValue::writeTo(std::string& output, int offset) const {
+	switch (type()) {
+	case JSON_NULL:
+		output += "null";
+		break;
+	case JSON_BOOL:
+		output += node->boolean ? "true" : "false";
+		break;
+	case JSON_DOUBLE:
+		append_double(output, node->number);
+		break;
+	case JSON_STRING:
+		output += '"';
+		append_escaped(output, getString());
+		output += '"';
+		break;
+	case JSON_VECTOR: {
+		output += '[';
+		bool contains_primitives = true;
+		for (size_t i = 0; i < node->size; ++i) {
+			JsonType element = child(i)->type;
+			if (element == JSON_MAP || element == JSON_VECTOR) {
+				contains_primitives = false;
+				break;
+			}
+		}
+		char delimiter = contains_primitives ? ' ' : '\n';
+		size_t indent = contains_primitives ? 0 : (offset + 1) * 4;
+		if (node->size != 0) {
+			output += delimiter;
+			for (size_t i = 0; i < node->size; ++i) {
+				output.append(indent, ' ');
+				FrozenValue(child(i), document).writeTo(output, offset + 1);
+				if (i + 1 < node->size) output += ',';
+				output += delimiter;
+			}
+			if (!contains_primitives) output.append(offset * 4, ' ');
+		}
+		output += ']';
+		break;
+	}
+	case JSON_MAP:
+		output += '{';
+		if (node->size != 0) {
+			output += '\n';
+			size_t indent = (offset + 1) * 4;
+			for (size_t i = 0; i < node->size; ++i) {
+				output.append(indent, ' ');
+				output += '"';
+				append_escaped(output, keyAt(i));
+				output += "\" : ";
+				valueAt(i).writeTo(output, offset + 1);
+				if (i + 1 < node->size) output += ',';
+				output += '\n';
+			}
+			output.append(offset * 4, ' ');
+		}
+		output += '}';
+		break;
+	}
+}
@@ -45,9 +45,61 @@ namespace smpj {
 		JSON_INVALID_CONTEXT,
 		JSON_INVALID_KEY,
 		JSON_INVALID_STRING,
-		JSON_OK
+		JSON_OK,
+		JSON_LIMIT_EXCEEDED,
+		JSON_SCHEMA_MISMATCH
 	};
 
+	// Hard limits for Json::tryParse. The defaults are also the nesting bound of the regular constructors.
+	struct ParseLimits {
+		size_t max_depth = 512;
+		size_t max_document_size = size_t(64) << 20;
+		size_t max_string_length = size_t(8) << 20;
+		size_t max_elements = size_t(8) << 20;	// values in the whole document
+	};
+
+	enum JsonPhase {
+		PHASE_TOKENIZE,
+		PHASE_VALIDATE,
+		PHASE_PARSE,
+		PHASE_DUMP,
+		PHASE_WRITE,
+		PHASE_COUNT
+	};
+
+	enum JsonOperation {
+		OP_PARSE,
+		OP_DUMP,
+		OP_WRITE
+	};
+
+	// How much a stats record covers. STATS_SHAPE also fills the node counts, depth and largest container
+	// of every parse, which takes one more walk over the new document.
+	enum JsonStatsDetail {
+		STATS_TIMING,
+		STATS_SHAPE
+	};
+
+	// Filled for every parse, stringDump and writeToFile when built with SMPJ_ENABLE_STATS.
+	// estimated_bytes is derived from container sizes, not counted at the allocator: the token buffer of a
+	// parse (plus its document with STATS_SHAPE) or the output buffer of a dump.
+	struct JsonStats {
+		JsonOperation operation = OP_PARSE;
+		JsonParseErrors result = JSON_NULL_EX;
+		uint64_t phase_ns[PHASE_COUNT] = {};
+		size_t input_bytes = 0;
+		size_t output_bytes = 0;
+		size_t token_count = 0;
+		size_t node_count[JSON_NULL + 1] = {};
+		size_t estimated_bytes = 0;
+		size_t max_depth = 0;
+		size_t largest_string = 0;
+		size_t largest_list = 0;
+		size_t largest_map = 0;
+	};
+
+	using JsonStatsCallback = std::function<void(const JsonStats&)>;
+
 	struct JsonToken
 	{
 		JsonTokenEnum type;
@@ -71,56 +123,122 @@ namespace smpj {
 		int position[2];
 	};
 
+	class JsonValue;
+
+	using JsonStringData = std::pmr::string;
+	using JsonListData = std::pmr::vector<std::shared_ptr<JsonValue>>;
+	using JsonMapData = std::pmr::unordered_map<std::pmr::string, std::shared_ptr<JsonValue>>;
+	using JsonNumberData = std::pmr::vector<double>;
+	// One byte per flag rather than vector<bool>'s bit proxies, so elements can be addressed and read directly.
+	using JsonBoolData = std::pmr::vector<uint8_t>;
+
+	// How a JsonList holds its elements: as nodes, or unboxed when they are all numbers or all booleans.
+	enum JsonListStorage {
+		LIST_BOXED,
+		LIST_NUMBERS,
+		LIST_BOOLS
+	};
+
+	// Allocates a node and its control block from resource. Nodes that own strings or containers
+	// take the resource as their last constructor argument and keep their storage on it too.
+	template<typename Node, typename... Args>
+	std::shared_ptr<Node> makeNode(std::pmr::memory_resource* resource, Args&&... args) {
+		std::pmr::polymorphic_allocator<Node> allocator(resource);
+		if constexpr (std::is_constructible_v<Node, Args&&..., std::pmr::memory_resource*>)
+			return std::allocate_shared<Node>(allocator, std::forward<Args>(args)..., resource);
+		else
+			return std::allocate_shared<Node>(allocator, std::forward<Args>(args)...);
+	}
+
+	// Converts input to a node on resource; defined at the end of this header.
+	template<typename Type>
+	std::shared_ptr<JsonValue> makeJson(Type&& input, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	// Serialization target. When a sink is set, containers hand the buffer to it between children once it
+	// holds chunk_size bytes, so saving a document never needs the whole dump in memory.
+	struct JsonWriter {
+		std::string buffer;
+		std::function<void(std::string_view)> sink;
+		size_t chunk_size = 0;
+
+		void flushIfFull() { if (sink && buffer.size() >= chunk_size) flush(); }
+		void flush() {
+			if (!sink || buffer.empty()) return;
+			sink(buffer);
+			buffer.clear();
+		}
+	};
+
 	class JsonValue {
 	public:
 		virtual ~JsonValue() = default;
-		virtual std::string asString(int offset = 0) const = NULL;
-		virtual JsonType type() const = NULL;
-		virtual std::shared_ptr<JsonValue> clone() const = 0;
+		std::string asString(int offset = 0) const { JsonWriter writer; writeTo(writer, offset); return std::move(writer.buffer); }
+		// Appends the serialized value to writer.buffer; containers write their children into the same writer.
+		virtual void writeTo(JsonWriter& writer, int offset = 0) const = 0;
+		virtual JsonType type() const = 0;
+		// nullptr clones onto the resource this value was built with (the default resource for scalars).
+		virtual std::shared_ptr<JsonValue> clone(std::pmr::memory_resource* resource = nullptr) const = 0;
 
 		virtual double getDouble() const { throw std::bad_cast(); }
 		virtual bool   getBool() const { throw std::bad_cast(); }
 		virtual std::string getString() const { throw std::bad_cast(); }
-		virtual std::vector<std::shared_ptr<JsonValue>> getList() const { throw std::bad_cast(); }
-		virtual const std::unordered_map<std::string, std::shared_ptr<JsonValue>>& getMap() const { throw std::bad_cast(); }
+		virtual const JsonListData& getList() const { throw std::bad_cast(); }
+		virtual const JsonMapData& getMap() const { throw std::bad_cast(); }
+
+		virtual JsonStringData* getStringPtr() const { throw std::bad_cast(); }
+		virtual JsonListData* getListPtr() const { throw std::bad_cast(); }
+		virtual JsonMapData* getMapPtr() const { throw std::bad_cast(); }
 
-		virtual std::string* getStringPtr() const { throw std::bad_cast(); }
-		virtual std::vector<std::shared_ptr<JsonValue>>* getListPtr() const { throw std::bad_cast(); }
-		virtual std::unordered_map<std::string, std::shared_ptr<JsonValue>>* getMapPtr() const { throw std::bad_cast(); }
+		// Elements of a list stored unboxed, nullptr for anything else. See JsonList.
+		virtual const JsonNumberData* getNumbers() const { return nullptr; }
+		virtual const JsonBoolData* getBools() const { return nullptr; }
 
 		virtual std::shared_ptr<JsonValue>& operator[](const std::string& key) { throw std::runtime_error("no [ string ] opertaor for this json value type"); }
 		virtual const std::shared_ptr<JsonValue>& operator[](const std::string& key) const { throw std::runtime_error("no [ stirng ] opertaor for this json value type"); }
 		virtual std::shared_ptr<JsonValue>& operator[](size_t index) { throw std::runtime_error("no [ index ] opertaor for this json value type"); }
 		virtual const std::shared_ptr<JsonValue>& operator[](size_t index) const { throw std::runtime_error("no [ index ] opertaor for this json value type"); }
+		// Read-only lookups through the const operator[], for callers that hold a non-const value.
+		const std::shared_ptr<JsonValue>& getItem(const std::string& key) const { return (*this)[key]; }
+		const std::shared_ptr<JsonValue>& getItem(size_t index) const { return (*this)[index]; }
+
+	protected:
+		static std::pmr::memory_resource* orDefault(std::pmr::memory_resource* resource) 
+			{ return resource ? resource : std::pmr::get_default_resource(); }
 	};
 
 	class JsonNull : public JsonValue {
 	public:
 		JsonNull() {};
-		std::string asString(int offset = 0) const override { return "null"; }
+		void writeTo(JsonWriter& writer, int offset = 0) const override { writer.buffer += "null"; }
 		JsonType type() const override { return JSON_NULL; }
-		std::shared_ptr<JsonValue> clone() const override { return std::make_shared<JsonNull>(); }
+		std::shared_ptr<JsonValue> clone(std::pmr::memory_resource* resource = nullptr) const override { return makeNode<JsonNull>(orDefault(resource)); }
 	};
 
 	class JsonString : public JsonValue {
-		std::string value;
-		std::string* value_ptr = nullptr;
+		JsonStringData value;
+		JsonStringData* value_ptr = nullptr;
 	public:
-		JsonString(const std::string& val) : value(val), value_ptr(&value) {}
-		std::string asString(int offset = 0) const override;
+		JsonString(std::string_view val, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) 
+			: value(val, resource), value_ptr(&value) {}
+		// Takes over the buffer of an rvalue JsonStringData that lives on resource.
+		template<typename Data, typename = std::enable_if_t<std::is_same_v<Data, JsonStringData>>>
+		JsonString(Data&& val, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: value(std::move(val), resource), value_ptr(&value) {}
+		void writeTo(JsonWriter& writer, int offset = 0) const override;
 		JsonType type() const override { return JSON_STRING; }
-		std::shared_ptr<JsonValue> clone() const override { return std::make_shared<JsonString>(value); }
-		std::string getString() const override { return value; }
-		std::string* getStringPtr() const override { return value_ptr; }
+		std::shared_ptr<JsonValue> clone(std::pmr::memory_resource* resource = nullptr) const override 
+			{ return makeNode<JsonString>(resource ? resource : value.get_allocator().resource(), value); }
+		std::string getString() const override { return std::string(value); }
+		JsonStringData* getStringPtr() const override { return value_ptr; }
 	};
 
 	class JsonDouble : public JsonValue {
 		double value;
 	public:
 		JsonDouble(const double val) : value(val) {}
-		std::string asString(int offset = 0) const override;
+		void writeTo(JsonWriter& writer, int offset = 0) const override;
 		JsonType type() const override { return JSON_DOUBLE; }
-		std::shared_ptr<JsonValue> clone() const override { return std::make_shared<JsonDouble>(value); }
+		std::shared_ptr<JsonValue> clone(std::pmr::memory_resource* resource = nullptr) const override { return makeNode<JsonDouble>(orDefault(resource), value); }
 		double getDouble() const override { return value; }
 	};
 
@@ -128,104 +246,618 @@ namespace smpj {
 		bool value;
 	public:
 		JsonBool(const bool val) : value(val) {}
-		std::string asString(int offset = 0) const override { return value ? "true" : "false"; }
+		void writeTo(JsonWriter& writer, int offset = 0) const override { writer.buffer += value ? "true" : "false"; }
 		JsonType type() const override { return JSON_BOOL; }
-		std::shared_ptr<JsonValue> clone() const override { return std::make_shared<JsonBool>(value); }
+		std::shared_ptr<JsonValue> clone(std::pmr::memory_resource* resource = nullptr) const override { return makeNode<JsonBool>(orDefault(resource), value); }
 		bool getBool() const override { return value; }
 	};
 
+	// A list whose elements are all numbers or all booleans may keep them in one contiguous buffer instead of
+	// a node per element; the parsers store such lists this way. getNumbers and getBools expose the buffer.
+	// Const reads never change the storage: getList, getItem and the const operator[] of an unboxed list return
+	// a boxed copy built once on first use (on new_delete_resource, so concurrent readers need no synchronized
+	// resource). Mutable access (getListPtr, the non-const operator[], append*, assign* and pack) converts the
+	// storage and invalidates pointers taken from getNumbers, getBools and getList; the non-const operator[]
+	// hands out a writable slot, so read elements with getItem to keep the list unboxed.
 	class JsonList : public JsonValue {
-		std::vector<std::shared_ptr<JsonValue>> value;
-		std::vector<std::shared_ptr<JsonValue>>* value_ptr;
+		// getListPtr is const in JsonValue but hands out mutable access, so it may convert the storage.
+		mutable std::variant<JsonListData, JsonNumberData, JsonBoolData> items;
+		mutable std::atomic<JsonListData*> boxed_view{ nullptr };
+		JsonListData& boxed() const;
+		const JsonListData& view() const;
+		void dropView() const { delete boxed_view.exchange(nullptr); }
 	public:
-		JsonList(const std::vector<std::shared_ptr<JsonValue>>& val) : value(val), value_ptr(&value) {}
-		JsonList() : value(), value_ptr(&value) {}
+		JsonList(const std::vector<std::shared_ptr<JsonValue>>& val, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) 
+			: items(std::in_place_index<LIST_BOXED>, val.begin(), val.end(), resource) {}
+		JsonList(JsonListData&& val, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: items(std::in_place_index<LIST_BOXED>, std::move(val), resource) {}
+		JsonList(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : items(std::in_place_index<LIST_BOXED>, resource) {}
+		~JsonList() override { dropView(); }
 		JsonType type() const override { return JSON_VECTOR; }
-		std::shared_ptr<JsonValue> clone() const override;
-		std::string asString(int offset = 0) const override;
-		std::vector<std::shared_ptr<JsonValue>> getList() const override { return value; }
-		std::vector<std::shared_ptr<JsonValue>>* getListPtr() const override { return value_ptr; }
+		std::shared_ptr<JsonValue> clone(std::pmr::memory_resource* resource = nullptr) const override;
+		void writeTo(JsonWriter& writer, int offset = 0) const override;
+		const JsonListData& getList() const override { return storage() == LIST_BOXED ? std::get<LIST_BOXED>(items) : view(); }
+		JsonListData* getListPtr() const override { return &boxed(); }
+		const JsonNumberData* getNumbers() const override { return std::get_if<LIST_NUMBERS>(&items); }
+		const JsonBoolData* getBools() const override { return std::get_if<LIST_BOOLS>(&items); }
 		std::shared_ptr<JsonValue>& operator[](size_t index) override;
 		const std::shared_ptr<JsonValue>& operator[](size_t index) const override;
+
+		JsonListStorage storage() const { return static_cast<JsonListStorage>(items.index()); }
+		size_t size() const { return std::visit([](const auto& data) { return data.size(); }, items); }
+		std::pmr::memory_resource* memoryResource() const 
+			{ return std::visit([](const auto& data) { return data.get_allocator().resource(); }, items); }
+
+		// An empty list takes the storage of the first value appended.
+		void appendNumber(double value);
+		void appendBool(bool value);
+		void append(std::shared_ptr<JsonValue> value);
+		// Appends anything makeJson accepts, moving rvalues into the list; numbers and booleans go through
+		// appendNumber and appendBool and so never allocate a node.
+		template<typename Type>
+		void emplace_back(Type&& input) {
+			using Decayed = std::decay_t<Type>;
+			if constexpr (std::is_same_v<Decayed, bool>) appendBool(input);
+			else if constexpr (std::is_arithmetic_v<Decayed>) appendNumber(static_cast<double>(input));
+			else append(makeJson(std::forward<Type>(input), memoryResource()));
+		}
+		// Capacity hint for the current storage; an empty list passes it on to the unboxed storage it switches to.
+		void reserve(size_t count) { std::visit([count](auto& data) { data.reserve(count); }, items); }
+		template<typename Iterator>
+		void assignNumbers(Iterator first, Iterator last) { dropView(); items.template emplace<LIST_NUMBERS>(first, last, memoryResource()); }
+		template<typename Iterator>
+		void assignBools(Iterator first, Iterator last) { dropView(); items.template emplace<LIST_BOOLS>(first, last, memoryResource()); }
+		// Switches a boxed list holding only numbers or only booleans to unboxed storage. Returns whether the list is unboxed.
+		bool pack();
 	};
 
 	class JsonMap : public JsonValue {
-		std::unordered_map<std::string, std::shared_ptr<JsonValue>> value;
-		std::unordered_map<std::string, std::shared_ptr<JsonValue>>* value_ptr;
+		JsonMapData value;
+		JsonMapData* value_ptr;
 	public:
-		JsonMap(const std::unordered_map<std::string, std::shared_ptr<JsonValue>>& val) : value(val), value_ptr(&value) {}
-		JsonMap() : value(0), value_ptr(&value) {}
+		JsonMap(const std::unordered_map<std::string, std::shared_ptr<JsonValue>>& val, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) 
+			: value(val.begin(), val.end(), val.size(), resource), value_ptr(&value) {}
+		JsonMap(JsonMapData&& val, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: value(std::move(val), resource), value_ptr(&value) {}
+		JsonMap(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : value(0, resource), value_ptr(&value) {}
 		JsonType type() const override { return JSON_MAP; }
-		std::shared_ptr<JsonValue> clone() const override;
-		std::string asString(int offset = 0) const override;
-		const std::unordered_map<std::string, std::shared_ptr<JsonValue>>& getMap() const override { return value; }
-		std::unordered_map<std::string, std::shared_ptr<JsonValue>>* getMapPtr() const override { return value_ptr; }
+		std::shared_ptr<JsonValue> clone(std::pmr::memory_resource* resource = nullptr) const override;
+		void writeTo(JsonWriter& writer, int offset = 0) const override;
+		const JsonMapData& getMap() const override { return value; }
+		JsonMapData* getMapPtr() const override { return value_ptr; }
 		std::shared_ptr<JsonValue>& operator[](const std::string& index) override;
 		const std::shared_ptr<JsonValue>& operator[](const std::string& index) const override;
+
+		// Inserts or replaces key, like assigning through operator[] but without the lookup copy of the key.
+		// key is a string or a JsonStringData, which is moved in; input is anything makeJson accepts, and rvalues
+		// are moved into the document.
+		template<typename Key, typename Type>
+		std::shared_ptr<JsonValue>& emplace(Key&& key, Type&& input) {
+			std::pmr::memory_resource* resource = value.get_allocator().resource();
+			JsonStringData stored_key(resource);
+			if constexpr (std::is_same_v<std::decay_t<Key>, JsonStringData>) stored_key = std::forward<Key>(key);
+			else stored_key.assign(std::string_view(key));
+			return value.insert_or_assign(std::move(stored_key), makeJson(std::forward<Type>(input), resource)).first->second;
+		}
+		void reserve(size_t count) { value.reserve(count); }
 	};
 
+	struct ParseResult;
+	class FrozenJson;
+	class Parser;
+	class PushParser;
+	class Schema;
+	class Projection;
+
+	// Scratch space of the single pass parser: decoded strings and the elements of the containers that are
+	// still open, so every list and map is allocated once at its final size. smpj::Parser keeps it between documents.
+	struct ParseBuffers {
+		std::string scratch;
+		std::vector<std::shared_ptr<JsonValue>> values;
+		std::vector<std::pair<JsonStringData, std::shared_ptr<JsonValue>>> entries;
+		// Elements of open lists that hold only numbers or only booleans (as 0 and 1), before they are packed.
+		std::vector<double> packed;
+		// Required keys already seen, one flag per required key of every open object that has any.
+		std::vector<char> required_seen;
+	};
+
+	// Outcome of Json::saveToFile. Times are wall clock; serialize_ns excludes the time spent in writes.
+	struct WriteResult {
+		size_t bytes_written = 0;
+		uint64_t serialize_ns = 0;
+		uint64_t write_ns = 0;
+		uint64_t sync_ns = 0;
+		uint64_t total_ns = 0;
+	};
+
+	// Every node, string and container of a document lives on the memory_resource given at construction.
+	// The resource must outlive the Json and every JsonValue taken out of it.
+	// Moving a Json never allocates; the moved-from Json holds no document, and anything but assigning to it or
+	// destroying it throws std::runtime_error.
 	class Json {
+		std::pmr::memory_resource* resource;
 		std::shared_ptr<JsonValue> root;
+		bool parse_failed = false;
 	public:
-		Json(std::fstream& file_stream, const std::string& path, ParseError* ParseError_ptr = nullptr);
-		Json(const std::string& json_as_string, ParseError* ParseError_ptr = nullptr);
-		Json(const char* string_literal, ParseError* ParseError_ptr = nullptr);
-		Json();
+		// The top level value may be a scalar as well as a map or a list.
+		// Malformed input is never parsed: the error is stored in ParseError_ptr, leaving the Json without a
+		// document, or thrown as std::runtime_error when ParseError_ptr is nullptr.
+		Json(std::fstream& file_stream, const std::string& path, ParseError* ParseError_ptr = nullptr,
+			std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+		Json(const std::string& json_as_string, ParseError* ParseError_ptr = nullptr,
+			std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+		Json(const char* string_literal, ParseError* ParseError_ptr = nullptr,
+			std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+		explicit Json(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 		Json(const Json& other);
+		Json(const Json& other, std::pmr::memory_resource* resource);
 		Json(Json&& other) noexcept;
+		Json& operator=(Json&& other) noexcept;
+
+		// Single pass parse for untrusted input: stops at the first error or exceeded limit and reports it
+		// through ParseResult::error instead of throwing.
+		static ParseResult tryParse(std::string_view input, const ParseLimits& limits = ParseLimits(),
+			std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+		// tryParse that also checks the document against schema while parsing; the first mismatch is
+		// reported as JSON_SCHEMA_MISMATCH at the start of the offending value or key.
+		static ParseResult tryParse(std::string_view input, const Schema& schema, const ParseLimits& limits = ParseLimits(),
+			std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+		// tryParse that builds only the keys selected by projection; the rest of the input is checked for
+		// syntax but never decoded, converted or allocated.
+		static ParseResult tryParse(std::string_view input, const Projection& projection, const ParseLimits& limits = ParseLimits(),
+			std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+		std::pmr::memory_resource* memoryResource() const { return resource; }
 
 		std::shared_ptr<JsonValue>& operator[] (const std::string& key);
 		const std::shared_ptr<JsonValue>& operator[] (const std::string& key) const;
 
 		std::shared_ptr<JsonValue>& operator[] (size_t index);
 		const std::shared_ptr<JsonValue>& operator[] (size_t index) const;
+		// Read-only lookups that keep an unboxed top level list unboxed, see JsonList.
+		const std::shared_ptr<JsonValue>& getItem(const std::string& key) const { return (*this)[key]; }
+		const std::shared_ptr<JsonValue>& getItem(size_t index) const { return (*this)[index]; }
 
-		void writeToFile(std::fstream& file_stream, const std::string& path);
+		// Builders for the top level object or list, see JsonMap::emplace and JsonList::emplace_back.
+		// Like operator[], they throw std::runtime_error for the other kind of top level value.
+		template<typename Key, typename Type>
+		std::shared_ptr<JsonValue>& emplace(Key&& key, Type&& input) { return rootMap().emplace(std::forward<Key>(key), std::forward<Type>(input)); }
+		template<typename Type>
+		void emplace_back(Type&& input) { rootList().emplace_back(std::forward<Type>(input)); }
+		void reserve(size_t count);
+
+		void writeToFile(std::fstream& file_stream, const std::string& path) const;
+
+		std::string stringDump() const;
+
+		// Crash safe save: the dump is written in large chunks to a temporary file next to path, flushed to
+		// disk and renamed over path, so path holds either the old or the new document, never a partial one.
+		// If path is a symbolic link, the file it points to is replaced and the link is kept.
+		// Throws std::runtime_error on failure, leaving path untouched.
+		WriteResult saveToFile(const std::string& path) const;
+		// saveToFile on a background thread. The document is deep copied before returning, so it may be
+		// changed or destroyed while the save runs. Errors are rethrown by the future's get().
+		// The future comes from std::async: its destructor waits for the save, so a discarded future makes
+		// this call as blocking as saveToFile.
+		std::future<WriteResult> saveToFileAsync(const std::string& path) const;
+
+		// Immutable, flat snapshot of the current document for lock free concurrent reads. See FrozenJson.
+		std::shared_ptr<const FrozenJson> freeze() const;
+
+		static constexpr bool statsEnabled() {
+#ifdef SMPJ_ENABLE_STATS
+			return true;
+#else
+			return false;
+#endif
+		}
+		// May be called while other threads parse; an operation that is finishing reports to the old or the new callback.
+		static void setStatsCallback(JsonStatsCallback callback);
+		static void setStatsDetail(JsonStatsDetail detail);
+		static const JsonStats& lastStats();
 
-		std::string stringDump() const {
-			return root->asString(0);
-		};
-		
 	private:
+		friend class Parser;
+		friend class PushParser;
+		friend class Schema;
+
+		Json(std::shared_ptr<JsonValue> root, std::pmr::memory_resource* resource) : resource(resource), root(std::move(root)) {}
+		const std::shared_ptr<JsonValue>& document() const;
+		JsonMap& rootMap();
+		JsonList& rootList();
+		static ParseResult parseBounded(std::string_view input, const ParseLimits& limits, std::pmr::memory_resource* resource,
+			ParseBuffers& buffers, const Schema* schema, const Projection* projection);
+
 		std::vector<JsonToken> tokenize(const std::string& json_string, ParseError* ParseError_ptr = nullptr);
 		std::vector<JsonToken> streaming_tokenize(std::fstream& filestream, ParseError* ParseError_ptr = nullptr);
 		void parse(const std::vector<JsonToken>& tokens);
 		bool validate(const std::vector<JsonToken>& tokens, ParseError* ParseError_ptr = nullptr);
 	};
 
+	struct ParseResult {
+		Json document;
+		ParseError error;
+
+		bool ok() const { return error.get_id() == JSON_OK; }
+		explicit operator bool() const { return ok(); }
+	};
+
+	// Parses documents one after another like Json::tryParse, but keeps its ParseBuffers between calls,
+	// so once warmed up a parse allocates nothing besides the resulting values.
+	// Those values still come from resource, one allocation per node, string and container, so a parse is
+	// only free of allocations with the pool: a nullptr resource makes the parser own an unsynchronized pool
+	// that recycles the memory of released documents; those documents must not outlive the parser.
+	// A Parser must not be shared between threads.
+	class Parser {
+	public:
+		explicit Parser(const ParseLimits& limits = ParseLimits(),
+			std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+		ParseResult parse(std::string_view input);
+		ParseResult parse(std::string_view input, const Schema& schema);
+		ParseResult parse(std::string_view input, const Projection& projection);
+
+		std::pmr::memory_resource* memoryResource() const { return resource; }
+		const ParseLimits& parseLimits() const { return limits; }
+		// Frees the retained buffers, e.g. after an unusually large document.
+		void releaseBuffers() { buffers = ParseBuffers(); }
+
+	private:
+		ParseLimits limits;
+		std::unique_ptr<std::pmr::unsynchronized_pool_resource> pool;
+		std::pmr::memory_resource* resource;
+		ParseBuffers buffers;
+	};
+
+	// Incremental parser for input that arrives in pieces, e.g. from a socket. Chunks may split the document
+	// anywhere, including inside strings, escapes, numbers and literals; only the unfinished token is carried
+	// over, never the chunks themselves. Values are added to the document as soon as they are complete.
+	// Documents are accepted or rejected as by Json::tryParse and errors carry the same ids, but the position
+	// and message may differ, e.g. an invalid escape split by a chunk boundary is reported once it is complete.
+	// Strings are decoded as their bytes arrive, into the buffer that the finished string node takes over.
+	// max_document_size applies to the total fed.
+	class PushParser {
+	public:
+		explicit PushParser(const ParseLimits& limits = ParseLimits(),
+			std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+		// Parses the next chunk. Returns false once the input is known to be invalid; further chunks are
+		// ignored and finish() reports the error.
+		bool feed(const char* data, size_t size);
+		bool feed(std::string_view chunk) { return feed(chunk.data(), chunk.size()); }
+		// Ends the input and returns the document or the first error. The parser is then ready for the next document.
+		ParseResult finish();
+
+		bool failed() const { return has_failed; }
+		const ParseError& error() const { return parse_error; }
+		size_t bytesFed() const { return bytes_fed; }
+		std::pmr::memory_resource* memoryResource() const { return resource; }
+
+	private:
+		enum Expect {
+			EXPECT_VALUE,
+			EXPECT_VALUE_OR_CLOSE,
+			EXPECT_KEY,
+			EXPECT_KEY_OR_CLOSE,
+			EXPECT_COLON,
+			EXPECT_COMMA_OR_CLOSE,
+			EXPECT_END
+		};
+		enum Token {
+			TOKEN_NONE,
+			TOKEN_STRING,
+			TOKEN_KEY,
+			TOKEN_NUMBER,
+			TOKEN_LITERAL
+		};
+		// Grammar position inside a number, so a number split across chunks ends where tryParse's would.
+		enum NumberState {
+			NUMBER_START,
+			NUMBER_SIGN,
+			NUMBER_ZERO,
+			NUMBER_INTEGER,
+			NUMBER_DOT,
+			NUMBER_FRACTION,
+			NUMBER_EXPONENT,
+			NUMBER_EXPONENT_SIGN,
+			NUMBER_EXPONENT_DIGITS
+		};
+		// Outcome of decoding one escape or multi-byte sequence of a string.
+		enum Unit {
+			UNIT_DONE,
+			UNIT_INCOMPLETE,
+			UNIT_INVALID
+		};
+		struct Frame {
+			JsonList* list;
+			JsonMapData* map;
+			JsonStringData key;
+		};
+
+		bool step(const char* data, size_t size, size_t& i);
+		bool startValue(const char* data, size_t size, size_t& i);
+		bool close(const char* data, size_t& i);
+		bool scanToken(const char* data, size_t size, size_t& i);
+		bool scanString(const char* data, size_t size, size_t& i);
+		Unit decodeUnit(const char* data, size_t size, size_t& at, const char*& what);
+		void appendDecoded(const char* data, size_t size);
+		bool endString(const char* data, size_t end);
+		bool numberAccepts(char c);
+		bool endNumber(std::string_view text, const char* data, size_t at);
+		bool carry(const char* data, size_t size);
+		void attach(std::shared_ptr<JsonValue> value);
+		void attachNumber(double value);
+		void attachBool(bool value);
+		void valueDone() { expect = stack.empty() ? EXPECT_END : EXPECT_COMMA_OR_CLOSE; }
+		bool fail(JsonParseErrors id, const char* what, const char* data, size_t at);
+		void advance(const char* data, size_t size);
+		void reset();
+
+		ParseLimits limits;
+		std::pmr::memory_resource* resource;
+		std::shared_ptr<JsonValue> root;
+		std::vector<Frame> stack;
+		Expect expect = EXPECT_VALUE;
+		Token token = TOKEN_NONE;
+		size_t token_start = 0;			// start of the current token in the chunk being fed
+		std::string token_text;			// beginning of a number split by a chunk boundary
+		JsonStringData decoded;			// the current string, decoded so far
+		std::string pending;			// start of an escape or UTF-8 sequence split by a chunk boundary
+		bool string_too_long = false;	// decoded passed max_string_length; the rest is only validated
+		NumberState number_state = NUMBER_START;
+		const char* literal = nullptr;
+		size_t literal_matched = 0;
+		size_t bytes_fed = 0;
+		size_t elements = 0;
+		size_t line = 1;
+		size_t column = 1;
+		bool has_failed = false;
+		ParseError parse_error;
+		uint64_t parse_ns = 0;
+	};
+
+	enum JsonSchemaType {
+		SCHEMA_NULL = 1 << 0,
+		SCHEMA_BOOLEAN = 1 << 1,
+		SCHEMA_INTEGER = 1 << 2,
+		SCHEMA_NUMBER = 1 << 3,
+		SCHEMA_STRING = 1 << 4,
+		SCHEMA_ARRAY = 1 << 5,
+		SCHEMA_OBJECT = 1 << 6,
+		SCHEMA_ANY = (1 << 7) - 1
+	};
+
+	// A JSON Schema compiled for Json::tryParse and Parser::parse. Supported keywords: type, enum (scalars only),
+	// minimum, maximum, exclusiveMinimum, exclusiveMaximum, minLength, maxLength, items (a single schema),
+	// minItems, maxItems, properties, required and additionalProperties (boolean or schema). Other keywords are
+	// ignored. The extra keyword "ignore": true on a property schema makes the parser check that value's
+	// syntax only and leave it out of the document. Throws std::invalid_argument for a malformed schema.
+	class Schema {
+	public:
+		static constexpr size_t npos = size_t(-1);
+
+		struct Property {
+			size_t schema;
+			size_t required_slot = npos;
+		};
+
+		struct Node {
+			unsigned types = SCHEMA_ANY;
+			bool ignore = false;
+
+			double minimum = -HUGE_VAL;
+			double maximum = HUGE_VAL;
+			double exclusive_minimum = -HUGE_VAL;
+			double exclusive_maximum = HUGE_VAL;
+			size_t min_length = 0;
+			size_t max_length = npos;
+
+			size_t items = npos;
+			size_t min_items = 0;
+			size_t max_items = npos;
+
+			std::map<std::string, Property, std::less<>> properties;
+			std::vector<std::string> required;
+			bool additional_allowed = true;
+			size_t additional = npos;
+
+			bool has_enum = false;
+			bool enum_null = false;
+			bool enum_true = false;
+			bool enum_false = false;
+			std::vector<double> enum_numbers;
+			std::vector<std::string> enum_strings;
+		};
+
+		explicit Schema(const Json& schema);
+
+		const Node& root() const { return nodes.front(); }
+		const Node& node(size_t index) const { return nodes[index]; }
+
+	private:
+		size_t compile(const JsonValue& schema);
+
+		std::vector<Node> nodes;
+	};
+
+	// Key paths to build when parsing, e.g. { "id", "ts", "payload.user" }; keys are separated by dots.
+	// A path selects the whole value at its end. Lists are transparent: the keys below a list apply to
+	// each of its elements. Keys outside every path are left out of the document, and so are scalars met
+	// before the end of a path (e.g. "payload": 5 above), whether as a value or as a list element.
+	class Projection {
+	public:
+		struct Node {
+			bool whole = false;
+			std::map<std::string, size_t, std::less<>> children;
+		};
+
+		Projection(std::initializer_list<std::string_view> paths);
+		explicit Projection(const std::vector<std::string>& paths);
+
+		const Node& root() const { return nodes.front(); }
+		const Node& node(size_t index) const { return nodes[index]; }
+
+	private:
+		void add(std::string_view path);
+
+		std::vector<Node> nodes;
+	};
+
+	// Read only view of one value inside a FrozenJson. Two raw pointers, so copying it costs nothing and
+	// never touches a reference count. Valid as long as the FrozenJson it came from is alive.
+	// A default constructed view (or the result of a failed find) is empty and converts to false.
+	class FrozenValue {
+	public:
+		struct Node {
+			JsonType type;
+			// Characters for strings, elements for lists, entries for maps.
+			uint32_t size;
+			struct Children {
+				// Index of the first child in the node array and, for maps, of the first entry in the key array.
+				uint32_t values;
+				uint32_t keys;
+			};
+			union {
+				double number;
+				bool boolean;
+				// Offset of string contents in the character buffer.
+				uint64_t offset;
+				Children children;
+			};
+		};
+		struct Key {
+			uint32_t hash;
+			uint32_t size;
+			uint64_t offset;
+		};
+
+		FrozenValue() = default;
+		FrozenValue(const Node* node, const FrozenJson* document) : node(node), document(document) {}
+
+		explicit operator bool() const { return node != nullptr; }
+		JsonType type() const { return node ? node->type : JSON_NULL; }
+		bool isNull() const { return !node || node->type == JSON_NULL; }
+
+		double getDouble() const;
+		bool getBool() const;
+		std::string_view getString() const;
+		// Number of list elements or map entries, 0 for scalars.
+		size_t size() const;
+
+		// Lists only. Throws std::out_of_range past the end.
+		FrozenValue operator[] (size_t index) const;
+		// Maps only. Never inserts: throws std::out_of_range for a missing key.
+		FrozenValue operator[] (std::string_view key) const;
+		// Maps only. Returns an empty view for a missing key.
+		FrozenValue find(std::string_view key) const;
+
+		// Map entries in storage order, which is unspecified (as for the unordered_map of a Json).
+		std::string_view keyAt(size_t index) const;
+		FrozenValue valueAt(size_t index) const;
+
+		std::string stringDump() const;
+
+	private:
+		const Node* child(size_t index) const;
+		const Key* key(size_t index) const;
+		std::string_view chars(uint64_t offset, size_t size) const;
+		void writeTo(std::string& output, int offset) const;
+
+		const Node* node = nullptr;
+		const FrozenJson* document = nullptr;
+	};
+
+	// A document laid out in three contiguous buffers: an array of fixed size nodes, with the children of
+	// every container stored next to each other, an array of map keys and one buffer holding all string
+	// contents. The keys of a map are sorted by hash and indexed by a bucket directory of the same length,
+	// bucket (hash * size) >> 32 holding the position of the first key that falls into it.
+	// Nothing in it is modified after construction, so any number of threads may read it without locking.
+	// Publish new versions by swapping a std::shared_ptr<const FrozenJson> with std::atomic_store;
+	// readers std::atomic_load it once and then work through FrozenValue views.
+	class FrozenJson {
+	public:
+		explicit FrozenJson(const JsonValue& root);
+		FrozenJson(const FrozenJson&) = delete;
+		FrozenJson& operator=(const FrozenJson&) = delete;
+
+		FrozenValue root() const { return FrozenValue(&nodes[0], this); }
+		FrozenValue operator[] (std::string_view key) const { return root()[key]; }
+		FrozenValue operator[] (size_t index) const { return root()[index]; }
+
+		size_t nodeCount() const { return nodes.size() + keys.size(); }
+		size_t stringBytes() const { return chars.size(); }
+
+		std::string stringDump() const { return root().stringDump(); }
+
+	private:
+		friend class FrozenValue;
+
+		void store(const JsonValue& value, size_t index);
+		uint64_t storeChars(std::string_view text);
+
+		std::vector<FrozenValue::Node> nodes;
+		std::vector<FrozenValue::Key> keys;
+		std::vector<uint32_t> buckets;
+		std::vector<char> chars;
+	};
+
+	// Rvalue containers and strings are moved from: their elements are moved into the new nodes, and the
+	// storage of JsonStringData, JsonListData and JsonMapData on resource is taken over without copying.
 	template<typename Type>
-	std::shared_ptr<JsonValue> makeJson(Type&& input) {
+	std::shared_ptr<JsonValue> makeJson(Type&& input, std::pmr::memory_resource* resource) {
 		using Decayed = std::decay_t<Type>;
+		constexpr bool movable = !std::is_lvalue_reference_v<Type> && !std::is_const_v<std::remove_reference_t<Type>>;
 
-		if constexpr (std::is_same_v<Decayed, std::shared_ptr<JsonValue>>) {
-			return input;
+		if constexpr (std::is_convertible_v<Decayed, std::shared_ptr<JsonValue>> && !std::is_same_v<Decayed, std::nullptr_t>) {
+			return std::forward<Type>(input);
+		}
+		else if constexpr (movable && std::is_same_v<Decayed, JsonStringData>) {
+			return makeNode<JsonString>(resource, std::move(input));
+		}
+		else if constexpr (movable && std::is_same_v<Decayed, JsonListData>) {
+			return makeNode<JsonList>(resource, std::move(input));
+		}
+		else if constexpr (movable && std::is_same_v<Decayed, JsonMapData>) {
+			return makeNode<JsonMap>(resource, std::move(input));
 		}
 		else if constexpr (std::is_base_of_v<JsonValue, Decayed>) {
-			return input.clone();
+			return input.clone(resource);
 		}
 		else if constexpr (std::is_same_v<Decayed, bool>) {
-			return std::make_shared<JsonBool>(input);
+			return makeNode<JsonBool>(resource, input);
 		}
 		else if constexpr (std::is_arithmetic_v<Decayed>) {
-			return std::make_shared<JsonDouble>(static_cast<double>(input));
-		}
-		else if constexpr (std::is_same_v<Decayed, const char*>) {
-			return std::make_shared<JsonString>(input);
+			return makeNode<JsonDouble>(resource, static_cast<double>(input));
 		}
-		else if constexpr (std::is_same_v<Decayed, std::string>) {
-			return std::make_shared<JsonString>(input);
+		else if constexpr (std::is_convertible_v<const Decayed&, std::string_view>) {
+			return makeNode<JsonString>(resource, std::string_view(input));
 		}
 		else if constexpr (is_vector<Decayed>::value) {
-			auto list = std::make_shared<JsonList>();
-			for (auto&& element : input) {
-				list->getListPtr()->push_back(makeJson(std::forward<decltype(element)>(element)));
+			using Element = typename Decayed::value_type;
+			auto list = makeNode<JsonList>(resource);
+			if constexpr (std::is_same_v<Element, bool>) {
+				list->assignBools(input.begin(), input.end());
+			}
+			else if constexpr (std::is_arithmetic_v<Element>) {
+				list->assignNumbers(input.begin(), input.end());
+			}
+			else {
+				JsonListData& elements = *list->getListPtr();
+				elements.reserve(input.size());
+				for (auto& element : input) {
+					if constexpr (movable) elements.push_back(makeJson(std::move(element), resource));
+					else elements.push_back(makeJson(element, resource));
+				}
 			}
 			return list;
 		}
 		else if constexpr (is_umap<Decayed>::value) {
-			auto object = std::make_shared<JsonMap>();
-			for (auto&& [key, val] : input) {
-				object->getMapPtr()->emplace(key, makeJson(std::forward<decltype(val)>(val)));
+			auto object = makeNode<JsonMap>(resource);
+			JsonMapData& entries = *object->getMapPtr();
+			entries.reserve(input.size());
+			for (auto& [key, val] : input) {
+				if constexpr (movable) entries.emplace(std::string_view(key), makeJson(std::move(val), resource));
+				else entries.emplace(std::string_view(key), makeJson(val, resource));
 			}
 			return object;
 		}
@@ -0,0 +1,310 @@
+#pragma once
+#include "Common.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SMPJ_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__) || defined(__AVX__)
+#define SMPJ_SSSE3 1
+#include <tmmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define SMPJ_AVX2 1
+#include <immintrin.h>
+#endif
+
+// Byte level helpers shared by the string decoders and JsonString: bulk scanning of string contents,
+// UTF-8 validation, \u escape decoding and escaping for output.
+namespace smpj {
+
+	inline size_t first_set_bit(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+		unsigned long index;
+		_BitScanForward(&index, static_cast<unsigned long>(mask));
+		return index;
+#else
+		return static_cast<size_t>(__builtin_ctz(mask));
+#endif
+	}
+
+	inline bool is_string_special(unsigned char c) {
+		return c == '"' || c == '\\' || c < 0x20 || c >= 0x80;
+	}
+
+	// Index of the first byte in [pos, size) that ends a plain ASCII run inside a string:
+	// a quote, a backslash, a control character or the lead byte of a multi-byte sequence.
+	// Returns size if there is none.
+	inline size_t find_string_special(const char* data, size_t pos, size_t size) {
+#ifdef SMPJ_SSE2
+		const __m128i quote = _mm_set1_epi8('"');
+		const __m128i backslash = _mm_set1_epi8('\\');
+		const __m128i space = _mm_set1_epi8(0x20);
+		while (pos + 16 <= size) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+			// Signed compare: bytes >= 0x80 are negative, so one compare catches control and non-ASCII bytes.
+			__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+				_mm_cmplt_epi8(chunk, space));
+			int mask = _mm_movemask_epi8(special);
+			if (mask != 0) return pos + first_set_bit(static_cast<unsigned>(mask));
+			pos += 16;
+		}
+#endif
+		while (pos < size && !is_string_special(static_cast<unsigned char>(data[pos]))) ++pos;
+		return pos;
+	}
+
+	inline bool needs_escape(unsigned char c) {
+		return c == '"' || c == '\\' || c < 0x20;
+	}
+
+	// Index of the first byte in [pos, size) that must be escaped in JSON output, or size if there is none.
+	// Bytes >= 0x80 are UTF-8 and pass through unchanged.
+	inline size_t find_escape_char(const char* data, size_t pos, size_t size) {
+#ifdef SMPJ_AVX2
+		const __m256i quote32 = _mm256_set1_epi8('"');
+		const __m256i backslash32 = _mm256_set1_epi8('\\');
+		const __m256i control32 = _mm256_set1_epi8(0x1F);
+		while (pos + 32 <= size) {
+			__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+			// max(c, 0x1F) == 0x1F is an unsigned c <= 0x1F.
+			__m256i special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32), _mm256_cmpeq_epi8(chunk, backslash32)),
+				_mm256_cmpeq_epi8(_mm256_max_epu8(chunk, control32), control32));
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(special));
+			if (mask != 0) return pos + first_set_bit(mask);
+			pos += 32;
+		}
+#endif
+#ifdef SMPJ_SSE2
+		const __m128i quote = _mm_set1_epi8('"');
+		const __m128i backslash = _mm_set1_epi8('\\');
+		const __m128i control = _mm_set1_epi8(0x1F);
+		while (pos + 16 <= size) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+			__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+				_mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+			if (mask != 0) return pos + first_set_bit(mask);
+			pos += 16;
+		}
+#endif
+		while (pos < size && !needs_escape(static_cast<unsigned char>(data[pos]))) ++pos;
+		return pos;
+	}
+
+	// Appends value with JSON escaping, copying the runs between escapes in one piece.
+	// Control characters without a short form are written as \u00XX.
+	template<typename String>
+	void append_escaped(String& out, std::string_view value) {
+		static const char hex[] = "0123456789abcdef";
+		const char* data = value.data();
+		size_t size = value.size();
+		size_t run_start = 0;
+		size_t pos = 0;
+		while ((pos = find_escape_char(data, pos, size)) < size) {
+			out.append(data + run_start, pos - run_start);
+			unsigned char current = static_cast<unsigned char>(data[pos]);
+			switch (current) {
+			case '"':  out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\b': out += "\\b"; break;
+			case '\f': out += "\\f"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default: {
+				char escaped[6] = { '\\', 'u', '0', '0', hex[current >> 4], hex[current & 0xF] };
+				out.append(escaped, sizeof(escaped));
+			}
+			}
+			run_start = ++pos;
+		}
+		out.append(data + run_start, size - run_start);
+	}
+
+	// Total length of a sequence whose lead byte is 0xC2..0xF4, derived from the lead byte alone.
+	inline size_t utf8_expected_length(unsigned char lead) {
+		if (lead >= 0xC2 && lead <= 0xDF) return 2;
+		if (lead >= 0xE0 && lead <= 0xEF) return 3;
+		if (lead >= 0xF0 && lead <= 0xF4) return 4;
+		return 0;
+	}
+
+	// Length of the well formed UTF-8 sequence starting at data (RFC 3629: no overlong forms,
+	// no surrogates, nothing above U+10FFFF), or 0 if it is invalid or truncated.
+	inline size_t utf8_sequence_length(const unsigned char* data, size_t available) {
+		size_t length = utf8_expected_length(data[0]);
+		if (length == 0 || length > available) return 0;
+
+		unsigned char second = data[1];
+		unsigned char low = 0x80, high = 0xBF;
+		switch (data[0]) {
+		case 0xE0: low = 0xA0; break;
+		case 0xED: high = 0x9F; break;
+		case 0xF0: low = 0x90; break;
+		case 0xF4: high = 0x8F; break;
+		}
+		if (second < low || second > high) return 0;
+		for (size_t i = 2; i < length; ++i) {
+			if ((data[i] & 0xC0) != 0x80) return 0;
+		}
+		return length;
+	}
+
+#ifdef SMPJ_SSSE3
+	// Nonzero where the 16 bytes of input, preceded by the 16 of previous, are not well formed UTF-8.
+	// This is the lookup algorithm of Keiser and Lemire ("Validating UTF-8 in less than one instruction per
+	// byte"): three nibble lookups classify each byte pair, and the pairs that must be the third or fourth
+	// byte of a sequence are checked separately. A sequence cut off at the end of input is not an error here.
+	inline __m128i utf8_block_errors(__m128i input, __m128i previous) {
+		const uint8_t too_short = 1 << 0, too_long = 1 << 1, overlong_3 = 1 << 2, too_large = 1 << 3;
+		const uint8_t surrogate = 1 << 4, overlong_2 = 1 << 5, too_large_1000 = 1 << 6, overlong_4 = 1 << 6;
+		const uint8_t two_conts = 1 << 7, carry = too_short | too_long | two_conts;
+		const __m128i low_nibble = _mm_set1_epi8(0x0F);
+
+		const __m128i byte_1_high_table = _mm_setr_epi8(
+			too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+			two_conts, two_conts, two_conts, two_conts,
+			too_short | overlong_2, too_short, too_short | overlong_3 | surrogate,
+			char(too_short | too_large | too_large_1000 | overlong_4));
+		const __m128i byte_1_low_table = _mm_setr_epi8(
+			char(carry | overlong_3 | overlong_2 | overlong_4), char(carry | overlong_2), char(carry), char(carry),
+			char(carry | too_large), char(carry | too_large | too_large_1000), char(carry | too_large | too_large_1000),
+			char(carry | too_large | too_large_1000), char(carry | too_large | too_large_1000), char(carry | too_large | too_large_1000),
+			char(carry | too_large | too_large_1000), char(carry | too_large | too_large_1000), char(carry | too_large | too_large_1000),
+			char(carry | too_large | too_large_1000 | surrogate), char(carry | too_large | too_large_1000),
+			char(carry | too_large | too_large_1000));
+		const __m128i byte_2_high_table = _mm_setr_epi8(
+			too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+			char(too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4),
+			char(too_long | overlong_2 | two_conts | overlong_3 | too_large),
+			char(too_long | overlong_2 | two_conts | surrogate | too_large),
+			char(too_long | overlong_2 | two_conts | surrogate | too_large),
+			too_short, too_short, too_short, too_short);
+
+		__m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+		__m128i byte_1_high = _mm_shuffle_epi8(byte_1_high_table, _mm_and_si128(_mm_srli_epi16(prev1, 4), low_nibble));
+		__m128i byte_1_low = _mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(prev1, low_nibble));
+		__m128i byte_2_high = _mm_shuffle_epi8(byte_2_high_table, _mm_and_si128(_mm_srli_epi16(input, 4), low_nibble));
+		__m128i special_cases = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+		// Only a byte that follows 111_____ by two or 1111____ by three ends up >= 0x80 here.
+		__m128i is_third_byte = _mm_subs_epu8(_mm_alignr_epi8(input, previous, 14), _mm_set1_epi8(char(0xE0 - 0x80)));
+		__m128i is_fourth_byte = _mm_subs_epu8(_mm_alignr_epi8(input, previous, 13), _mm_set1_epi8(char(0xF0 - 0x80)));
+		__m128i must_be_continuation = _mm_and_si128(_mm_or_si128(is_third_byte, is_fourth_byte), _mm_set1_epi8(char(0x80)));
+		return _mm_xor_si128(must_be_continuation, special_cases);
+	}
+
+	// Number of bytes at the end of a 16 byte block that belong to a sequence continuing past it.
+	inline size_t utf8_incomplete_tail(const unsigned char* block_end) {
+		if (block_end[-1] >= 0xC0) return 1;
+		if (block_end[-2] >= 0xE0) return 2;
+		if (block_end[-3] >= 0xF0) return 3;
+		return 0;
+	}
+#endif
+
+	// Advances from the lead byte at pos over well formed multi-byte sequences and the plain ASCII between
+	// them. Stops at a quote, backslash or control byte, at an invalid sequence (the only case that leaves a
+	// byte >= 0x80 at the result), or after 16 ASCII bytes in a row, where find_string_special is faster again.
+	// With SSSE3, whole 16 byte blocks are validated at once; a block holding a special byte or an error is left
+	// to the scalar loop, starting from the last character boundary, so it reports the same position.
+	inline size_t skip_utf8_run(const char* data, size_t pos, size_t size) {
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+#ifdef SMPJ_SSSE3
+		const __m128i quote = _mm_set1_epi8('"');
+		const __m128i backslash = _mm_set1_epi8('\\');
+		const __m128i control = _mm_set1_epi8(0x1F);
+		__m128i previous = _mm_setzero_si128();
+		size_t boundary = pos;
+		while (pos + 16 <= size) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+			__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+				_mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+			if (_mm_movemask_epi8(special) != 0) break;
+			if (_mm_movemask_epi8(chunk) == 0) {
+				// Plain ASCII: fine unless the previous block ended inside a sequence, and better left to find_string_special.
+				if (boundary == pos) return pos;
+				break;
+			}
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(utf8_block_errors(chunk, previous), _mm_setzero_si128())) != 0xFFFF) break;
+			previous = chunk;
+			pos += 16;
+			boundary = pos - utf8_incomplete_tail(bytes + pos);
+		}
+		pos = boundary;
+#endif
+		size_t ascii_run = 0;
+		while (pos < size) {
+			unsigned char current = bytes[pos];
+			if (current < 0x80) {
+				if (is_string_special(current) || ++ascii_run > 16) return pos;
+				++pos;
+				continue;
+			}
+			ascii_run = 0;
+			if (current >= 0xC2 && current <= 0xDF && pos + 1 < size && (bytes[pos + 1] & 0xC0) == 0x80) {
+				pos += 2;
+				continue;
+			}
+			size_t length = utf8_sequence_length(bytes + pos, size - pos);
+			if (length == 0) return pos;
+			pos += length;
+		}
+		return pos;
+	}
+
+	inline int parse_hex4(const char* data) {
+		int value = 0;
+		for (int i = 0; i < 4; ++i) {
+			char c = data[i];
+			value <<= 4;
+			if (c >= '0' && c <= '9')		value |= c - '0';
+			else if (c >= 'a' && c <= 'f')	value |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F')	value |= c - 'A' + 10;
+			else return -1;
+		}
+		return value;
+	}
+
+	template<typename String>
+	void append_utf8(String& out, uint32_t code_point) {
+		if (code_point < 0x80) {
+			out += static_cast<char>(code_point);
+		}
+		else if (code_point < 0x800) {
+			out += static_cast<char>(0xC0 | (code_point >> 6));
+			out += static_cast<char>(0x80 | (code_point & 0x3F));
+		}
+		else if (code_point < 0x10000) {
+			out += static_cast<char>(0xE0 | (code_point >> 12));
+			out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code_point & 0x3F));
+		}
+		else {
+			out += static_cast<char>(0xF0 | (code_point >> 18));
+			out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code_point & 0x3F));
+		}
+	}
+
+	// Decodes the hex digits of a \u escape, data pointing just past the 'u'. A high surrogate must be
+	// followed by a \u escaped low surrogate. Returns the number of bytes consumed or 0 with error set.
+	inline size_t decode_unicode_escape(const char* data, size_t available, uint32_t& code_point, const char*& error) {
+		if (available < 4) { error = "Truncated unicode escape"; return 0; }
+		int unit = parse_hex4(data);
+		if (unit < 0) { error = "Invalid unicode escape"; return 0; }
+		if (unit >= 0xDC00 && unit <= 0xDFFF) { error = "Unpaired low surrogate in unicode escape"; return 0; }
+		if (unit < 0xD800 || unit > 0xDBFF) {
+			code_point = static_cast<uint32_t>(unit);
+			return 4;
+		}
+
+		if (available < 10 || data[4] != '\\' || data[5] != 'u') { error = "Unpaired high surrogate in unicode escape"; return 0; }
+		int low = parse_hex4(data + 6);
+		if (low < 0xDC00 || low > 0xDFFF) { error = "Unpaired high surrogate in unicode escape"; return 0; }
+		code_point = 0x10000 + ((static_cast<uint32_t>(unit) - 0xD800) << 10) + (static_cast<uint32_t>(low) - 0xDC00);
+		return 10;
+	}
+}
@@ -12,6 +12,6 @@ struct is_umap : std::false_type {};
 
 template<typename K, typename V, typename Hash, typename Eq, typename Alloc>
 struct is_umap<std::unordered_map<K, V, Hash, Eq, Alloc>>
-	: std::bool_constant<std::is_same_v<K, std::string>> {}; 
+	: std::bool_constant<std::is_convertible_v<const K&, std::string_view>> {}; 
 
 template<class> inline constexpr bool always_false = false;
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "Common.h"
 #include "Json.h"
 
+using namespace smpj;
+
 int main() {
 	std::fstream json_stream;
 	Json test(json_stream, "test_json.json");
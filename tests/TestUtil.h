@@ -0,0 +1,91 @@
+#pragma once
+#include "Common.h"
+#include "Json.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory_resource>
+
+// Minimal checks shared by the test executables. Each executable prints every failed check and
+// returns testResult() from main, which is non-zero if there was any.
+
+namespace smpj_test {
+	using namespace smpj;
+
+	inline std::atomic<int> failures{ 0 };
+
+	inline std::string describe(const std::string& value) { return value; }
+	inline std::string describe(std::string_view value) { return std::string(value); }
+	template<typename Type>
+	std::string describe(const Type& value) { return std::to_string(value); }
+
+	// Counts what a document takes from its resource, to check where storage comes from and how often.
+	class CountingResource : public std::pmr::memory_resource {
+	public:
+		size_t allocations = 0;
+		size_t live_bytes = 0;
+	private:
+		void* do_allocate(size_t bytes, size_t alignment) override {
+			++allocations;
+			live_bytes += bytes;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+			live_bytes -= bytes;
+			std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+	};
+
+	inline bool sameValue(FrozenValue a, FrozenValue b) {
+		if (a.type() != b.type() || a.size() != b.size()) return false;
+		switch (a.type()) {
+		case JSON_MAP:
+			for (size_t i = 0; i < a.size(); ++i) {
+				FrozenValue other = b.find(a.keyAt(i));
+				if (!other || !sameValue(a.valueAt(i), other)) return false;
+			}
+			return true;
+		case JSON_VECTOR:
+			for (size_t i = 0; i < a.size(); ++i) {
+				if (!sameValue(a[i], b[i])) return false;
+			}
+			return true;
+		default:
+			return a.stringDump() == b.stringDump();
+		}
+	}
+
+	// Feeds doc in chunks of every size from 1 to its length and compares each outcome with Json::tryParse.
+	// Documents are compared structurally since map order may differ; errors must agree on the id.
+	inline void checkPushParser(const std::string& doc, const ParseLimits& limits = ParseLimits()) {
+		ParseResult expected = Json::tryParse(doc, limits);
+		PushParser parser(limits);
+		for (size_t chunk = 1; chunk <= std::max<size_t>(doc.size(), 1); ++chunk) {
+			for (size_t pos = 0; pos < doc.size(); pos += chunk) parser.feed(doc.data() + pos, std::min(chunk, doc.size() - pos));
+			ParseResult got = parser.finish();
+			bool same = got.ok() == expected.ok() && got.error.get_id() == expected.error.get_id()
+				&& (!got.ok() || sameValue(got.document.freeze()->root(), expected.document.freeze()->root()));
+			if (!same) {
+				++failures;
+				std::printf("PushParser differs from tryParse for %s at chunk size %zu\n  expected: %s\n  got: %s\n",
+					doc.substr(0, 60).c_str(), chunk, expected.error.info().c_str(), got.error.info().c_str());
+				return;
+			}
+		}
+	}
+
+	inline int testResult() {
+		std::printf("%d failure(s)\n", failures.load());
+		return failures == 0 ? 0 : 1;
+	}
+}
+
+#define CHECK(condition) \
+	do { if (!(condition)) { ++smpj_test::failures; std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+#define CHECK_EQ(actual, expected) \
+	do { if (!((actual) == (expected))) { ++smpj_test::failures; std::printf("%s:%d: %s == %s failed\n  got: %s\n", __FILE__, __LINE__, #actual, #expected, smpj_test::describe(actual).c_str()); } } while (0)
+#define CHECK_THROWS(Exception, statement) \
+	do { bool thrown = false; try { statement; } catch (const Exception&) { thrown = true; } \
+		if (!thrown) { ++smpj_test::failures; std::printf("%s:%d: %s did not throw %s\n", __FILE__, __LINE__, #statement, #Exception); } } while (0)
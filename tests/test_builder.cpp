@@ -0,0 +1,103 @@
+#include "TestUtil.h"
+
+using namespace smpj;
+using namespace smpj_test;
+
+namespace {
+
+	const char* const long_text = "a string long enough to leave the small string buffer";
+
+	void testMovedFromJson() {
+		Json source("{\"k\": [1, 2]}");
+		Json target(std::move(source));
+		const Json& moved = source;
+		CHECK_THROWS(std::runtime_error, source.stringDump());
+		CHECK_THROWS(std::runtime_error, source["k"]);
+		CHECK_THROWS(std::runtime_error, moved["k"]);
+		CHECK_THROWS(std::runtime_error, moved[0]);
+		CHECK_THROWS(std::runtime_error, source.freeze());
+		CHECK_THROWS(std::runtime_error, Json copy(source));
+		source = std::move(target);
+		CHECK_EQ(source["k"]->getList().size(), size_t(2));
+	}
+
+	// Moving a Json hands over its tree and takes nothing from the resource.
+	void testMoveAllocatesNothing() {
+		CountingResource resource;
+		Json doc(&resource);
+		doc.emplace("k", std::string(long_text));
+		size_t allocations = resource.allocations;
+		Json moved(std::move(doc));
+		CHECK_EQ(resource.allocations, allocations);
+		Json assigned(&resource);
+		allocations = resource.allocations;
+		assigned = std::move(moved);
+		CHECK_EQ(resource.allocations, allocations);
+		CHECK_EQ(assigned["k"]->getString(), std::string(long_text));
+	}
+
+	// Rvalue pmr strings and containers on the document's resource are moved in with their buffers.
+	void testEmplaceMovesBuffers() {
+		CountingResource resource;
+		Json doc(&resource);
+
+		JsonStringData text(long_text, &resource);
+		const char* text_data = text.data();
+		doc.emplace("text", std::move(text));
+		CHECK(doc["text"]->getStringPtr()->data() == text_data);
+
+		JsonListData elements(&resource);
+		elements.push_back(makeJson(1, &resource));
+		elements.push_back(makeJson(std::string("x"), &resource));
+		const std::shared_ptr<JsonValue>* elements_data = elements.data();
+		doc.emplace("list", std::move(elements));
+		CHECK(doc["list"]->getList().data() == elements_data);
+
+		JsonMapData entries(&resource);
+		auto inner = makeJson(true, &resource);
+		entries.emplace(JsonStringData("flag", &resource), inner);
+		doc.emplace(JsonStringData("map", &resource), std::move(entries));
+		CHECK(doc["map"]->getItem("flag") == inner);
+
+		std::vector<JsonStringData> strings;
+		strings.emplace_back(long_text, &resource);
+		const char* first_data = strings[0].data();
+		doc.emplace("strings", std::move(strings));
+		CHECK(doc["strings"]->getItem(0)->getStringPtr()->data() == first_data);
+
+		doc.emplace("text", 5);
+		CHECK_EQ(doc["text"]->getDouble(), 5.0);
+		CHECK_EQ(doc.getItem("list")->getItem(1)->getString(), std::string("x"));
+	}
+
+	// Numbers and booleans are appended unboxed, into the capacity reserved up front.
+	void testEmplaceBackIntoReserved() {
+		CountingResource resource;
+		Json doc("[]", nullptr, &resource);
+		doc.reserve(8);
+		doc.emplace_back(1);
+		size_t allocations = resource.allocations;
+		for (int i = 2; i <= 8; ++i) doc.emplace_back(i * 0.5);
+		CHECK_EQ(resource.allocations, allocations);
+		CHECK_EQ(doc.stringDump(), std::string("[ 1, 1, 1.5, 2, 2.5, 3, 3.5, 4 ]"));
+
+		Json flags("[]", nullptr, &resource);
+		flags.emplace_back(true);
+		flags.emplace_back(false);
+		CHECK_EQ(flags.stringDump(), std::string("[ true, false ]"));
+
+		// A value of another kind boxes the list and keeps what came before.
+		doc.emplace_back(std::string("end"));
+		CHECK_EQ(doc.getItem(0)->getDouble(), 1.0);
+		CHECK_EQ(doc.getItem(8)->getString(), std::string("end"));
+		CHECK_THROWS(std::runtime_error, doc.emplace("k", 1));
+	}
+}
+
+int main() {
+	testMovedFromJson();
+	testMoveAllocatesNothing();
+	testEmplaceMovesBuffers();
+	testEmplaceBackIntoReserved();
+	return testResult();
+}
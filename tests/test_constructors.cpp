@@ -0,0 +1,47 @@
+#include "TestUtil.h"
+
+using namespace smpj;
+using namespace smpj_test;
+
+namespace {
+
+	void testScalarRoots() {
+		CHECK_EQ(Json("42").stringDump(), std::string("42"));
+		CHECK_EQ(Json(" -1.5e2 ").stringDump(), std::string("-150"));
+		CHECK_EQ(Json("\"text\"").stringDump(), std::string("\"text\""));
+		CHECK_EQ(Json("\"\"").stringDump(), std::string("\"\""));
+		CHECK_EQ(Json(std::string("true")).stringDump(), std::string("true"));
+		CHECK_EQ(Json("false").stringDump(), std::string("false"));
+		CHECK_EQ(Json("null").stringDump(), std::string("null"));
+		Json scalar("7");
+		CHECK_THROWS(std::runtime_error, scalar["key"]);
+		CHECK_THROWS(std::runtime_error, scalar[0]);
+	}
+
+	void testInvalidInputIsNotParsed() {
+		CHECK_THROWS(std::runtime_error, Json(std::string(100000, '[')));
+		CHECK_THROWS(std::runtime_error, Json("{\"a\":}"));
+		ParseError error;
+		Json deep(std::string(100000, '['), &error);
+		CHECK_EQ(error.get_id(), JSON_LIMIT_EXCEEDED);
+
+		// A Json whose input failed to parse says so instead of claiming it was moved from.
+		Json broken("{\"a\":", &error);
+		CHECK(error.get_id() != JSON_OK);
+		std::string message;
+		try { broken.stringDump(); }
+		catch (const std::runtime_error& e) { message = e.what(); }
+		CHECK_EQ(message, std::string("Json holds no document: its input failed to parse"));
+		Json moved(std::move(broken));
+		message.clear();
+		try { broken.stringDump(); }
+		catch (const std::runtime_error& e) { message = e.what(); }
+		CHECK_EQ(message, std::string("use of a moved-from Json"));
+	}
+}
+
+int main() {
+	testScalarRoots();
+	testInvalidInputIsNotParsed();
+	return testResult();
+}
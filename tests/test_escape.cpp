@@ -0,0 +1,43 @@
+#include "TestUtil.h"
+
+using namespace smpj;
+using namespace smpj_test;
+
+namespace {
+
+	// Control characters without a short escape are written as \u00XX; '/' needs no escape and is left alone.
+	void testControlCharacters() {
+		ParseResult result = Json::tryParse("[\"a\\u0001b\\u001fc\\u007f\"]");
+		CHECK(result.ok());
+		CHECK_EQ(result.document[0]->getString(), std::string("a\x01" "b\x1f" "c\x7f"));
+		CHECK_EQ(result.document.stringDump(), std::string("[ \"a\\u0001b\\u001fc\x7f\" ]"));
+
+		std::string all;
+		for (int c = 0; c < 0x20; ++c) all += static_cast<char>(c);
+		Json list("[null]");
+		list[0] = makeJson(all);
+		CHECK_EQ(list.stringDump(), std::string("[ \"\\u0000\\u0001\\u0002\\u0003\\u0004\\u0005\\u0006\\u0007\\b\\t\\n\\u000b\\f\\r\\u000e\\u000f"
+			"\\u0010\\u0011\\u0012\\u0013\\u0014\\u0015\\u0016\\u0017\\u0018\\u0019\\u001a\\u001b\\u001c\\u001d\\u001e\\u001f\" ]"));
+		CHECK_EQ(Json::tryParse(list.stringDump()).document[0]->getString(), all);
+	}
+
+	void testSolidusIsNotEscaped() {
+		ParseResult result = Json::tryParse("{\"url\": \"http:\\/\\/example.com/a/b\"}");
+		CHECK(result.ok());
+		CHECK_EQ(result.document["url"]->getString(), std::string("http://example.com/a/b"));
+		CHECK(result.document.stringDump().find("\"http://example.com/a/b\"") != std::string::npos);
+	}
+
+	void testQuotesAndBackslashes() {
+		Json list("[null]");
+		list[0] = makeJson(std::string("say \"hi\" \\ back"));
+		CHECK_EQ(list.stringDump(), std::string("[ \"say \\\"hi\\\" \\\\ back\" ]"));
+	}
+}
+
+int main() {
+	testControlCharacters();
+	testSolidusIsNotEscaped();
+	testQuotesAndBackslashes();
+	return testResult();
+}
@@ -0,0 +1,86 @@
+#include "TestUtil.h"
+
+#include <thread>
+#include <vector>
+
+using namespace smpj;
+using namespace smpj_test;
+
+namespace {
+
+	void testFrozenLookups() {
+		Json doc("{\"name\": \"cfg\", \"limits\": {\"max\": 10, \"on\": true}, \"tags\": [\"a\", \"b\", null], \"ratio\": 0.5, \"empty\": {}}");
+		std::shared_ptr<const FrozenJson> frozen = doc.freeze();
+		CHECK_EQ(frozen->root().type(), JSON_MAP);
+		CHECK_EQ(frozen->root().size(), size_t(5));
+		CHECK_EQ((*frozen)["name"].getString(), std::string_view("cfg"));
+		CHECK_EQ((*frozen)["limits"]["max"].getDouble(), 10.0);
+		CHECK((*frozen)["limits"]["on"].getBool());
+		CHECK_EQ((*frozen)["tags"].size(), size_t(3));
+		CHECK_EQ((*frozen)["tags"][1].getString(), std::string_view("b"));
+		CHECK((*frozen)["tags"][2].isNull());
+		CHECK_EQ((*frozen)["ratio"].getDouble(), 0.5);
+		CHECK_EQ((*frozen)["empty"].size(), size_t(0));
+		CHECK(sameValue(frozen->root(), Json::tryParse(doc.stringDump()).document.freeze()->root()));
+
+		// Lookups never insert.
+		CHECK(!(*frozen)["limits"].find("missing"));
+		CHECK_THROWS(std::out_of_range, (*frozen)["missing"]);
+		CHECK_THROWS(std::out_of_range, (*frozen)["tags"][3]);
+		CHECK_EQ(frozen->root().size(), size_t(5));
+		CHECK_THROWS(std::runtime_error, (*frozen)["tags"]["x"]);
+		CHECK_THROWS(std::runtime_error, (*frozen)["name"][0]);
+	}
+
+	// The snapshot is a copy: later changes to the Json do not show through it.
+	void testSnapshotIsIndependent() {
+		Json doc("{\"a\": 1, \"b\": [1, 2]}");
+		std::shared_ptr<const FrozenJson> frozen = doc.freeze();
+		doc["a"] = makeJson(2.0);
+		doc["c"] = makeJson(std::string("new"));
+		CHECK_EQ((*frozen)["a"].getDouble(), 1.0);
+		CHECK(!frozen->root().find("c"));
+		CHECK_EQ(doc.freeze()->root()["a"].getDouble(), 2.0);
+	}
+
+	// Many maps large enough to spread over the bucket directory, each key found through it.
+	void testLargeMaps() {
+		std::string text = "{";
+		for (int i = 0; i < 500; ++i) text += (i ? ",\"k" : "\"k") + std::to_string(i) + "\": " + std::to_string(i);
+		text += "}";
+		std::shared_ptr<const FrozenJson> frozen = Json(text).freeze();
+		for (int i = 0; i < 500; ++i) CHECK_EQ((*frozen)["k" + std::to_string(i)].getDouble(), double(i));
+		CHECK(!frozen->root().find("k500"));
+	}
+
+	// Readers share one snapshot without locks while a writer publishes new versions with atomic_store.
+	void testConcurrentReaders() {
+		std::shared_ptr<const FrozenJson> current = Json("{\"version\": 0, \"values\": [0, 0, 0]}").freeze();
+		std::atomic<bool> done{ false };
+		std::vector<std::thread> readers;
+		for (int t = 0; t < 4; ++t) {
+			readers.emplace_back([&]() {
+				while (!done) {
+					std::shared_ptr<const FrozenJson> snapshot = std::atomic_load(&current);
+					double version = (*snapshot)["version"].getDouble();
+					FrozenValue values = (*snapshot)["values"];
+					for (size_t i = 0; i < values.size(); ++i) CHECK_EQ(values[i].getDouble(), version);
+				}
+			});
+		}
+		for (int version = 1; version <= 200; ++version) {
+			std::string v = std::to_string(version);
+			std::atomic_store(&current, Json("{\"version\": " + v + ", \"values\": [" + v + ", " + v + ", " + v + "]}").freeze());
+		}
+		done = true;
+		for (std::thread& reader : readers) reader.join();
+	}
+}
+
+int main() {
+	testFrozenLookups();
+	testSnapshotIsIndependent();
+	testLargeMaps();
+	testConcurrentReaders();
+	return testResult();
+}
@@ -0,0 +1,41 @@
+#include "TestUtil.h"
+
+using namespace smpj;
+using namespace smpj_test;
+
+namespace {
+
+	// Nodes, strings and containers of a document come from its resource, and a copy moves to the new one.
+	void testDocumentUsesItsResource() {
+		CountingResource first, second;
+		{
+			ParseResult result = Json::tryParse("{\"key long enough to leave the small string buffer\": [1, \"x\", {\"b\": null}]}", ParseLimits(), &first);
+			CHECK(result.ok());
+			CHECK(first.allocations > 0);
+			Json copy(result.document, &second);
+			CHECK(second.allocations > 0);
+			CHECK_EQ(copy.stringDump(), result.document.stringDump());
+		}
+		CHECK_EQ(first.live_bytes, size_t(0));
+		CHECK_EQ(second.live_bytes, size_t(0));
+	}
+
+	// Lookups on a const document build their scratch key outside the default resource, which may be gone.
+	void testLookupAfterDefaultResourceChange() {
+		Json doc("{\"a\": 1}");
+		{
+			std::pmr::monotonic_buffer_resource arena;
+			std::pmr::memory_resource* previous = std::pmr::set_default_resource(&arena);
+			CHECK_THROWS(std::out_of_range, static_cast<const Json&>(doc)["a key long enough to leave the small string buffer"]);
+			std::pmr::set_default_resource(previous);
+		}
+		CHECK_THROWS(std::out_of_range, static_cast<const Json&>(doc)["another key long enough to make the scratch string grow again"]);
+		CHECK_EQ(doc["a"]->getDouble(), 1.0);
+	}
+}
+
+int main() {
+	testDocumentUsesItsResource();
+	testLookupAfterDefaultResourceChange();
+	return testResult();
+}
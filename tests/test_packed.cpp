@@ -0,0 +1,79 @@
+#include "TestUtil.h"
+
+#include <thread>
+
+using namespace smpj;
+using namespace smpj_test;
+
+namespace {
+
+	void testPackedListAccess() {
+		const std::shared_ptr<const JsonValue> list = makeJson(std::vector<double>{ 1, 2, 3 });
+		const JsonNumberData* numbers = list->getNumbers();
+		CHECK(numbers != nullptr);
+		CHECK_EQ(list->getList().size(), size_t(3));
+		CHECK_EQ((*list)[2]->getDouble(), 3.0);
+		CHECK(list->getNumbers() == numbers);
+
+		std::string doc = "[";
+		for (int i = 0; i < 1000; ++i) doc += (i ? "," : "") + std::to_string(i);
+		doc += "]";
+		const Json shared(doc);
+		auto read = [&shared]() { for (size_t i = 0; i < 1000; ++i) CHECK_EQ(shared[i]->getDouble(), double(i)); };
+		std::thread first(read), second(read);
+		first.join();
+		second.join();
+		CHECK_THROWS(std::out_of_range, shared[1000]);
+
+		Json mutable_list(doc);
+		mutable_list[3] = makeJson(std::string("x"));
+		CHECK_EQ(mutable_list[3]->getString(), std::string("x"));
+		CHECK_EQ(mutable_list[4]->getDouble(), 4.0);
+	}
+
+	// Reading through a non-const document leaves the list unboxed.
+	void testReadsKeepListsPacked() {
+		Json doc("{\"l\": [1, 2, 3], \"b\": [true, false, true]}");
+		CHECK_EQ(doc["l"]->getItem(0)->getDouble(), 1.0);
+		CHECK_EQ(doc.getItem("l")->getItem(2)->getDouble(), 3.0);
+		CHECK(doc["l"]->getNumbers() != nullptr);
+		CHECK_EQ(doc["b"]->getItem(1)->getBool(), false);
+		CHECK(doc["b"]->getBools() != nullptr);
+		CHECK_THROWS(std::runtime_error, doc["l"]->getItem(3));
+
+		Json list("[4, 5]");
+		CHECK_EQ(list.getItem(1)->getDouble(), 5.0);
+		CHECK_EQ(list.stringDump(), std::string("[ 4, 5 ]"));
+
+		// A writable slot has to box the list.
+		(*doc["l"])[0] = makeJson(std::string("x"));
+		CHECK(doc["l"]->getNumbers() == nullptr);
+		CHECK_EQ(doc["l"]->getItem(0)->getString(), std::string("x"));
+	}
+
+	// Booleans are stored one per byte and read back as they were written.
+	void testPackedBools() {
+		auto list = std::static_pointer_cast<JsonList>(makeJson(std::vector<bool>{ true, false, true }));
+		const JsonBoolData* bools = list->getBools();
+		CHECK(bools != nullptr);
+		if (!bools) return;
+		CHECK_EQ(bools->size(), size_t(3));
+		const uint8_t* data = bools->data();
+		CHECK(data[0] == 1 && data[1] == 0 && data[2] == 1);
+		list->appendBool(false);
+		CHECK_EQ(list->getBools()->back(), uint8_t(0));
+		CHECK_EQ(list->asString(), std::string("[ true, false, true, false ]"));
+		CHECK(list->clone()->getBools() != nullptr);
+
+		ParseResult result = Json::tryParse("{\"b\": [false, true]}");
+		CHECK(result.ok() && result.document["b"]->getBools() != nullptr);
+		CHECK_EQ(result.document["b"]->getItem(1)->getBool(), true);
+	}
+}
+
+int main() {
+	testPackedListAccess();
+	testReadsKeepListsPacked();
+	testPackedBools();
+	return testResult();
+}
@@ -0,0 +1,80 @@
+#include "TestUtil.h"
+
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+using namespace smpj;
+using namespace smpj_test;
+
+// Counts every global allocation of the process, so a test can see what a parse allocates.
+// std::pmr::new_delete_resource allocates through the aligned overloads.
+static std::atomic<size_t> allocations{ 0 };
+
+void* operator new(size_t size) {
+	++allocations;
+	if (void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+	++allocations;
+	size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+	if (void* p = _aligned_malloc(size ? size : 1, align)) return p;
+#else
+	if (void* p = std::aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align)) return p;
+#endif
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+#ifdef _WIN32
+void operator delete(void* p, std::align_val_t) noexcept { _aligned_free(p); }
+#else
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+#endif
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+
+namespace {
+
+	void testParserReuseAfterFailure() {
+		Parser parser;
+		for (int i = 0; i < 3; ++i) CHECK(!parser.parse("[[1,2,3,4,5,6,7,8"));
+		ParseResult result = parser.parse("[[1,2],[true,false],3]");
+		CHECK(result.ok());
+		CHECK_EQ(result.document.stringDump(), Json("[[1,2],[true,false],3]").stringDump());
+	}
+
+	// Once the pool and the buffers have grown, parsing a document of the same shape allocates nothing.
+	void testPooledParserDoesNotAllocate() {
+		const std::string doc = "{\"id\": 42, \"name\": \"a name longer than the small string buffer\", "
+			"\"tags\": [\"x\", \"y\"], \"scores\": [1.5, 2.5], \"nested\": {\"ok\": true, \"none\": null}}";
+		Parser pooled(ParseLimits(), nullptr);
+		for (int i = 0; i < 3; ++i) CHECK(pooled.parse(doc).ok());
+		size_t before = allocations;
+		for (int i = 0; i < 100; ++i) {
+			ParseResult result = pooled.parse(doc);
+			CHECK(result.ok());
+		}
+		CHECK_EQ(allocations - before, size_t(0));
+
+		// With a regular resource only the parser's own buffers are reused; the values are still allocated.
+		Parser regular;
+		for (int i = 0; i < 3; ++i) CHECK(regular.parse(doc).ok());
+		before = allocations;
+		CHECK(regular.parse(doc).ok());
+		size_t per_parse = allocations - before;
+		CHECK(per_parse > 0);
+		before = allocations;
+		CHECK(Json::tryParse(doc).ok());
+		CHECK(allocations - before > per_parse);
+	}
+}
+
+int main() {
+	testParserReuseAfterFailure();
+	testPooledParserDoesNotAllocate();
+	return testResult();
+}
@@ -0,0 +1,67 @@
+#include "TestUtil.h"
+
+using namespace smpj;
+using namespace smpj_test;
+
+namespace {
+
+	// Compares structurally, since map order is unspecified.
+	void checkProjection(const Projection& projection, const std::string& input, const std::string& expected) {
+		ParseResult result = Json::tryParse(input, projection);
+		CHECK(result.ok());
+		if (!result.ok()) { std::printf("  %s\n", result.error.info().c_str()); return; }
+		bool same = sameValue(result.document.freeze()->root(), Json(expected).freeze()->root());
+		CHECK(same);
+		if (!same) std::printf("  input: %s\n  got: %s\n  expected: %s\n", input.c_str(), result.document.stringDump().c_str(), expected.c_str());
+
+		Parser parser;
+		CHECK(sameValue(parser.parse(input, projection).document.freeze()->root(), Json(expected).freeze()->root()));
+	}
+
+	void testNestedPaths() {
+		Projection projection{ "id", "ts", "payload.user" };
+		checkProjection(projection,
+			R"({"id": 1, "ts": "t", "other": {"x": 1}, "payload": {"user": {"name": "a", "roles": [1, 2]}, "body": "b"}})",
+			R"({"id": 1, "ts": "t", "payload": {"user": {"name": "a", "roles": [1, 2]}}})");
+		checkProjection(projection, R"({"id": [1, {"a": 2}], "payload": {"body": "b"}})", R"({"id": [1, {"a": 2}], "payload": {}})");
+
+		Projection deep{ "a.b.c", "a.d" };
+		checkProjection(deep, R"({"a": {"b": {"c": 1, "x": 2}, "d": [true, false], "e": 3}, "f": 4})", R"({"a": {"b": {"c": 1}, "d": [true, false]}})");
+	}
+
+	// A path that stops partway keeps the containers it passed through and nothing else.
+	void testPathsThatStopPartway() {
+		Projection projection{ "payload.user.name" };
+		checkProjection(projection, R"({"payload": {"user": {}}})", R"({"payload": {"user": {}}})");
+		checkProjection(projection, R"({"payload": {}})", R"({"payload": {}})");
+		checkProjection(projection, R"({"id": 1})", "{}");
+	}
+
+	// Scalars where the path expects a container are left out, as value or as list element.
+	void testScalarsWhereContainerExpected() {
+		Projection projection{ "id", "ts", "payload.user" };
+		checkProjection(projection, R"({"id": 1, "payload": 5})", R"({"id": 1})");
+		checkProjection(projection, R"({"id": 1, "payload": "text"})", R"({"id": 1})");
+		checkProjection(projection, R"({"id": 1, "payload": null})", R"({"id": 1})");
+		checkProjection(projection, R"({"payload": [1, true, "x", {"user": 2, "body": 3}, null, [4, {"user": 5}]]})",
+			R"({"payload": [{"user": 2}, [{"user": 5}]]})");
+		checkProjection(projection, R"({"payload": [1, 2, 3]})", R"({"payload": []})");
+		checkProjection(projection, "5", "{}");
+	}
+
+	// Values that are left out are still checked.
+	void testSkippedValuesAreValidated() {
+		Projection projection{ "payload.user" };
+		CHECK_EQ(Json::tryParse(R"({"payload": tru})", projection).error.get_id(), JSON_INVALID_LITERAL);
+		CHECK_EQ(Json::tryParse(R"({"payload": [1, "a)", projection).error.get_id(), JSON_INVALID_STRING);
+		CHECK_EQ(Json::tryParse(R"({"other": {"a": }})", projection).error.get_id(), JSON_UNEXPECTED_SYMBOL);
+	}
+}
+
+int main() {
+	testNestedPaths();
+	testPathsThatStopPartway();
+	testScalarsWhereContainerExpected();
+	testSkippedValuesAreValidated();
+	return testResult();
+}
@@ -0,0 +1,95 @@
+#include "TestUtil.h"
+
+using namespace smpj;
+using namespace smpj_test;
+
+namespace {
+
+	void testPushParserChunks() {
+		const char* documents[] = {
+			"{\"a\": [1, 2.5, -3e10, true, false, null], \"b\": {\"c\": \"x\\\"y\\\\z\\u00e9\\ud83d\\ude00\"}}",
+			"  [\n\"\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\", 0, -0.0, 1E+2, {}, [], [[[]]], {\"\": \"\"}]  \n",
+			"[true, false, true]", "[1, 2, \"three\"]", "[[1, 2], [true], [null]]",
+			"\"just a string\"", "123", "-0", "true", "null", "  false ",
+			"", "   ", "{", "[1,", "[1 2]", "{\"a\" 1}", "{\"a\":}", "[1]]", "{\"a\":1,}", "[1,]", "{]", "[}", "1 2", "{1:2}",
+			"[01]", "[-01]", "[1.]", "[1.e3]", "[1e]", "[1e+]", "[-]", "[.5]", "[1e400]", "[1.5.5]",
+			"tru", "nul", "[truex]", "\"abc", "\"a\\", "\"\\x\"", "\"\\u12\"", "\"\\ud800\"", "\"\x01\"", "\"\xFF\"",
+			"{\"a\":1,\"a\":2}", "\n\n  [1,\n  x]",
+		};
+		for (const char* doc : documents) checkPushParser(doc);
+
+		ParseLimits tight;
+		tight.max_depth = 3;
+		tight.max_elements = 6;
+		tight.max_string_length = 4;
+		for (const char* doc : { "[[[1]]]", "[[[[1]]]]", "[1,2,3,4,5]", "[1,2,3,4,5,6]", "[\"abcd\"]", "[\"abcde\"]", "[\"\\u0041bcd\"]" })
+			checkPushParser(doc, tight);
+	}
+
+	// Numbers end where tryParse's would, so split numbers report the same error in the same place.
+	void testPushParserNumbers() {
+		for (const char* doc : { "[01]", "[-01]", "[1.]", "[1e+]", "[-a]", "-", "[1e5e]" }) {
+			std::string text = doc;
+			std::string expected = Json::tryParse(text).error.info();
+			for (size_t chunk = 1; chunk <= text.size(); ++chunk) {
+				PushParser parser;
+				for (size_t pos = 0; pos < text.size(); pos += chunk) parser.feed(text.substr(pos, chunk));
+				CHECK_EQ(parser.finish().error.info(), expected);
+			}
+		}
+		CHECK_EQ(Json::tryParse("[01]").error.get_id(), JSON_UNEXPECTED_SYMBOL);
+	}
+
+	// Escapes and multi-byte sequences split at every byte; the string arrives decoded, and split units with an
+	// error fail as tryParse does.
+	void testPushParserSplitStrings() {
+		const char* documents[] = {
+			"[\"a\\u00e9\\ud83d\\ude00\xE6\x97\xA5\\n\\\"\\/\\\\\xF0\x9F\x98\x80z\", {\"k\\u0041\\t\": \"\xC3\xA9\"}]",
+			"[\"\\ud83d\\u0041\"]", "[\"\\ud83dx\"]", "[\"\\ude00\"]", "[\"\\u12g4\"]", "[\"\\q\"]",
+			"[\"\xE6\x97\"]", "[\"\xE6\x97x\"]", "[\"\xF0\x9F\x98\"]", "[\"\xED\xA0\x80\"]", "[\"\xC3\xA9\x80\"]",
+			"{\"\\ud83d\": 1}", "{\"a\xFF\": 1}", "[\"\\u00", "[\"\xE6\x97",
+		};
+		for (const char* doc : documents) checkPushParser(doc);
+
+		ParseLimits tight;
+		tight.max_string_length = 4;
+		for (const char* doc : { "[\"\\u00e9\\u00e9\"]", "[\"\\u00e9\\u00e9x\"]", "[\"abcde\\q\"]", "[\"abcde\xFF\"]", "{\"abcde\": 1}" })
+			checkPushParser(doc, tight);
+
+		std::string text = "[\"";
+		std::string expected;
+		for (int i = 0; i < 300; ++i) {
+			text += "x\\u00e9\\ud83d\\ude00\xD0\xBF\\n";
+			expected += "x\xC3\xA9\xF0\x9F\x98\x80\xD0\xBF\n";
+		}
+		text += "\"]";
+		for (size_t chunk : { 1, 2, 3, 5, 7, 11, 13, 64 }) {
+			PushParser parser;
+			for (size_t pos = 0; pos < text.size(); pos += chunk) parser.feed(text.substr(pos, chunk));
+			ParseResult result = parser.finish();
+			CHECK(result.ok());
+			CHECK(result.ok() && result.document[0]->getString() == expected);
+		}
+	}
+
+	void testPushParserReuse() {
+		PushParser parser;
+		parser.feed("[1,");
+		CHECK(!parser.feed("x"));
+		CHECK(!parser.feed("2]"));
+		CHECK_EQ(parser.finish().error.get_id(), JSON_UNEXPECTED_SYMBOL);
+		parser.feed("{\"k\":");
+		parser.feed("[true]}");
+		ParseResult result = parser.finish();
+		CHECK(result.ok());
+		CHECK(result.document["k"]->getBools() != nullptr);
+	}
+}
+
+int main() {
+	testPushParserChunks();
+	testPushParserNumbers();
+	testPushParserSplitStrings();
+	testPushParserReuse();
+	return testResult();
+}
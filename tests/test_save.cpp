@@ -0,0 +1,131 @@
+#include "TestUtil.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+using namespace smpj;
+using namespace smpj_test;
+namespace fs = std::filesystem;
+
+namespace {
+
+	// Every test works in its own empty directory, so leftover temporary files are easy to spot.
+	fs::path freshDirectory(const char* name) {
+		fs::path directory = fs::path("simplyjson_save_tests") / name;
+		fs::remove_all(directory);
+		fs::create_directories(directory);
+		return directory;
+	}
+
+	std::string readFile(const fs::path& path) {
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream contents;
+		contents << file.rdbuf();
+		return contents.str();
+	}
+
+	size_t fileCount(const fs::path& directory) {
+		size_t count = 0;
+		for (auto& entry : fs::directory_iterator(directory)) { (void)entry; ++count; }
+		return count;
+	}
+
+	void testSaveReplacesFile() {
+		fs::path directory = freshDirectory("replace");
+		fs::path path = directory / "doc.json";
+		std::ofstream(path) << "old contents that are longer than the new document";
+
+		Json doc("{\"a\": [1, 2, 3]}");
+		WriteResult result = doc.saveToFile(path.string());
+		CHECK_EQ(readFile(path), doc.stringDump());
+		CHECK_EQ(result.bytes_written, doc.stringDump().size());
+		CHECK_EQ(fileCount(directory), size_t(1));
+
+		// Larger than one chunk, so the file is written in several pieces.
+		std::string big = "[";
+		for (int i = 0; i < 200000; ++i) big += (i ? ",\"" : "\"") + std::to_string(i) + "\"";
+		big += "]";
+		Json large(big);
+		result = large.saveToFile(path.string());
+		CHECK_EQ(result.bytes_written, large.stringDump().size());
+		CHECK_EQ(readFile(path), large.stringDump());
+		CHECK_EQ(fileCount(directory), size_t(1));
+	}
+
+	// A failed save throws, leaves the target as it was and removes its temporary file.
+	void testFailedSaveCleansUp() {
+		fs::path directory = freshDirectory("failure");
+		Json doc("{\"a\": 1}");
+		CHECK_THROWS(std::runtime_error, doc.saveToFile((directory / "missing" / "doc.json").string()));
+		CHECK_EQ(fileCount(directory), size_t(0));
+
+		// The rename fails when the target is a non-empty directory.
+		fs::path occupied = directory / "occupied";
+		fs::create_directories(occupied / "child");
+		CHECK_THROWS(std::runtime_error, doc.saveToFile(occupied.string()));
+		CHECK(fs::is_directory(occupied / "child"));
+		CHECK_EQ(fileCount(directory), size_t(1));
+	}
+
+	void testAsyncSave() {
+		fs::path directory = freshDirectory("async");
+		fs::path path = directory / "doc.json";
+		Json doc("{\"a\": \"before\"}");
+		std::string expected = doc.stringDump();
+		std::future<WriteResult> pending = doc.saveToFileAsync(path.string());
+		doc["a"] = makeJson(std::string("after"));
+		WriteResult result = pending.get();
+		CHECK_EQ(result.bytes_written, expected.size());
+		CHECK_EQ(readFile(path), expected);
+
+		std::future<WriteResult> failing = doc.saveToFileAsync((directory / "missing" / "doc.json").string());
+		CHECK_THROWS(std::runtime_error, failing.get());
+		CHECK_EQ(fileCount(directory), size_t(1));
+	}
+
+	void testSaveKeepsMode() {
+#ifndef _WIN32
+		fs::path directory = freshDirectory("mode");
+		std::string path = (directory / "doc.json").string();
+		Json doc("{\"secret\": 1}");
+		doc.saveToFile(path);
+		::chmod(path.c_str(), 0600);
+		doc.saveToFile(path);
+		struct stat info;
+		CHECK(::stat(path.c_str(), &info) == 0);
+		CHECK_EQ(info.st_mode & 0777, 0600u);
+#endif
+	}
+
+	// Saving through a symbolic link replaces the file it points to and keeps the link.
+	void testSaveThroughSymlink() {
+#ifndef _WIN32
+		fs::path directory = freshDirectory("symlink");
+		fs::path target = directory / "real.json";
+		fs::path link = directory / "link.json";
+		std::ofstream(target) << "{}";
+		fs::create_symlink("real.json", link);
+
+		Json doc("{\"a\": 1}");
+		doc.saveToFile(link.string());
+		CHECK(fs::is_symlink(link));
+		CHECK_EQ(readFile(target), doc.stringDump());
+		CHECK_EQ(fileCount(directory), size_t(2));
+#endif
+	}
+}
+
+int main() {
+	testSaveReplacesFile();
+	testFailedSaveCleansUp();
+	testAsyncSave();
+	testSaveKeepsMode();
+	testSaveThroughSymlink();
+	fs::remove_all("simplyjson_save_tests");
+	return testResult();
+}
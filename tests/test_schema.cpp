@@ -0,0 +1,62 @@
+#include "TestUtil.h"
+
+using namespace smpj;
+using namespace smpj_test;
+
+namespace {
+
+	void testSchemaMismatches() {
+		Schema schema(Json(R"({
+			"type": "object",
+			"required": ["id", "name"],
+			"additionalProperties": false,
+			"properties": {
+				"id": {"type": "integer", "minimum": 0},
+				"name": {"type": "string", "minLength": 2, "maxLength": 4},
+				"kind": {"enum": ["a", "b", 3, null]},
+				"score": {"type": ["number", "null"], "exclusiveMaximum": 10},
+				"tags": {"type": "array", "items": {"type": "string"}, "maxItems": 2, "minItems": 1}
+			}
+		})"));
+		struct Case { const char* doc; const char* error; };
+		const Case cases[] = {
+			{ R"({"id": 1, "name": "ab", "kind": 3, "score": null, "tags": ["x"]})", "ParseError id: 10 - No errors found at: 0 0" },
+			{ R"({"id": 1.5, "name": "ab"})", "ParseError id: 12 - Number is not an integer at: 1 8" },
+			{ R"({"id": -1, "name": "ab"})", "ParseError id: 12 - Number is below the schema minimum at: 1 8" },
+			{ R"({"id": 1, "name": "a"})", "ParseError id: 12 - String is shorter than the schema minLength at: 1 19" },
+			{ R"({"id": 1, "name": "abcde"})", "ParseError id: 12 - String is longer than the schema maxLength at: 1 19" },
+			{ R"({"id": 1})", "ParseError id: 12 - Missing required key 'name' at: 1 9" },
+			{ R"({"id": 1, "name": "ab", "extra": 1})", "ParseError id: 12 - Key 'extra' is not allowed by schema at: 1 25" },
+			{ R"({"id": 1, "name": "ab", "kind": "c"})", "ParseError id: 12 - Value is not in the schema enum at: 1 33" },
+			{ R"({"id": 1, "name": "ab", "score": 10})", "ParseError id: 12 - Number is above the schema maximum at: 1 34" },
+			{ R"({"id": 1, "name": "ab", "tags": []})", "ParseError id: 12 - List has fewer items than the schema requires at: 1 34" },
+			{ R"({"id": 1, "name": "ab", "tags": ["x", 2]})", "ParseError id: 12 - Value type does not match schema at: 1 39" },
+			{ R"({"id": 1, "name": "ab", "tags": ["x", "y", "z"]})", "ParseError id: 12 - List has more items than the schema allows at: 1 44" },
+			{ "[1]", "ParseError id: 12 - Value type does not match schema at: 1 1" },
+			{ "{\n  \"id\": 1,\n  \"name\": true\n}", "ParseError id: 12 - Value type does not match schema at: 3 11" },
+		};
+		Parser parser;
+		for (const Case& test : cases) {
+			CHECK_EQ(Json::tryParse(test.doc, schema).error.info(), test.error);
+			CHECK_EQ(parser.parse(test.doc, schema).error.info(), test.error);
+		}
+	}
+
+	// A schema built from a Json without a document throws instead of dereferencing it.
+	void testSchemaFromEmptyJson() {
+		ParseError error;
+		Json broken("{\"type\":", &error);
+		CHECK_THROWS(std::runtime_error, Schema{ broken });
+		Json moved("{\"type\": \"object\"}");
+		Json target(std::move(moved));
+		CHECK_THROWS(std::runtime_error, Schema{ moved });
+		Schema scalar(Json("true"));
+		CHECK(Json::tryParse("[1]", scalar).ok());
+	}
+}
+
+int main() {
+	testSchemaMismatches();
+	testSchemaFromEmptyJson();
+	return testResult();
+}
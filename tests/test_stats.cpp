@@ -0,0 +1,87 @@
+#include "TestUtil.h"
+
+#include <vector>
+
+using namespace smpj;
+using namespace smpj_test;
+
+namespace {
+
+	// Without SMPJ_ENABLE_STATS nothing is recorded and the callback is never called.
+	void testStatsDisabled() {
+		int calls = 0;
+		Json::setStatsCallback([&calls](const JsonStats&) { ++calls; });
+		Json doc("{\"a\": [1, 2]}");
+		doc.stringDump();
+		Json::setStatsCallback(nullptr);
+		CHECK_EQ(calls, 0);
+		CHECK_EQ(Json::lastStats().input_bytes, size_t(0));
+		CHECK_EQ(Json::lastStats().token_count, size_t(0));
+	}
+
+	void testCallback() {
+		std::vector<JsonStats> records;
+		Json::setStatsCallback([&records](const JsonStats& stats) { records.push_back(stats); });
+		const std::string input = "{\"a\": [1, 2, 3], \"b\": \"text\"}";
+		Json doc(input);
+		std::string dump = doc.stringDump();
+		CHECK(Json::tryParse("[1,").error.get_id() != JSON_OK);
+		Json::setStatsCallback(nullptr);
+		Json("[1]");
+
+		CHECK_EQ(records.size(), size_t(3));
+		if (records.size() != 3) return;
+		CHECK_EQ(records[0].operation, OP_PARSE);
+		CHECK_EQ(records[0].result, JSON_OK);
+		CHECK_EQ(records[0].input_bytes, input.size());
+		CHECK(records[0].token_count > 0);
+		CHECK(records[0].estimated_bytes > 0);
+
+		CHECK_EQ(records[1].operation, OP_DUMP);
+		CHECK_EQ(records[1].result, JSON_OK);
+		CHECK_EQ(records[1].output_bytes, dump.size());
+		CHECK(records[1].estimated_bytes >= dump.size());
+		CHECK_EQ(records[1].node_count[JSON_MAP], size_t(0));
+
+		CHECK_EQ(records[2].operation, OP_PARSE);
+		CHECK_EQ(records[2].result, JSON_MISSING_VALUE);
+	}
+
+	void testLastStats() {
+		Json::setStatsDetail(STATS_TIMING);
+		ParseResult result = Json::tryParse("{\"a\": [1, 2, 3], \"b\": {\"c\": \"text\"}}");
+		CHECK(result.ok());
+		const JsonStats& timing = Json::lastStats();
+		CHECK_EQ(timing.operation, OP_PARSE);
+		CHECK_EQ(timing.result, JSON_OK);
+		CHECK_EQ(timing.node_count[JSON_MAP], size_t(0));
+		CHECK_EQ(timing.max_depth, size_t(0));
+
+		Json::setStatsDetail(STATS_SHAPE);
+		result = Json::tryParse("{\"a\": [1, 2, 3], \"b\": {\"c\": \"text\"}}");
+		Json::setStatsDetail(STATS_TIMING);
+		const JsonStats& shape = Json::lastStats();
+		CHECK_EQ(shape.node_count[JSON_MAP], size_t(2));
+		CHECK_EQ(shape.node_count[JSON_VECTOR], size_t(1));
+		CHECK_EQ(shape.node_count[JSON_DOUBLE], size_t(3));
+		CHECK_EQ(shape.node_count[JSON_STRING], size_t(1));
+		CHECK_EQ(shape.max_depth, size_t(3));
+		CHECK_EQ(shape.largest_list, size_t(3));
+		CHECK_EQ(shape.largest_map, size_t(2));
+		CHECK_EQ(shape.largest_string, size_t(4));
+		CHECK(shape.estimated_bytes > 0);
+
+		result.document.stringDump();
+		CHECK_EQ(Json::lastStats().operation, OP_DUMP);
+		CHECK_EQ(Json::lastStats().node_count[JSON_MAP], size_t(0));
+	}
+}
+
+int main() {
+	if (Json::statsEnabled()) {
+		testCallback();
+		testLastStats();
+	}
+	else testStatsDisabled();
+	return testResult();
+}
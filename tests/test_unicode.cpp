@@ -0,0 +1,90 @@
+#include "TestUtil.h"
+
+using namespace smpj;
+using namespace smpj_test;
+
+namespace {
+
+	void testSurrogatePairs() {
+		ParseResult result = Json::tryParse("[\"\\ud83d\\ude00\", \"a\\uD834\\uDD1Eb\", \"\\u00e9\"]");
+		CHECK(result.ok());
+		CHECK_EQ(result.document[0]->getString(), std::string("\xF0\x9F\x98\x80"));
+		CHECK_EQ(result.document[1]->getString(), std::string("a\xF0\x9D\x84\x9E" "b"));
+		CHECK_EQ(result.document[2]->getString(), std::string("\xC3\xA9"));
+		CHECK_EQ(Json::tryParse(result.document.stringDump()).document[0]->getString(), std::string("\xF0\x9F\x98\x80"));
+
+		CHECK_EQ(Json::tryParse("[\"\\ud83d\"]").error.info(), "ParseError id: 9 - Unpaired high surrogate in unicode escape at: 1 5");
+		CHECK_EQ(Json::tryParse("[\"\\ud83dx\"]").error.info(), "ParseError id: 9 - Unpaired high surrogate in unicode escape at: 1 5");
+		CHECK_EQ(Json::tryParse("[\"\\ud83d\\u0041\"]").error.info(), "ParseError id: 9 - Unpaired high surrogate in unicode escape at: 1 5");
+		CHECK_EQ(Json::tryParse("[\"\\ude00\"]").error.info(), "ParseError id: 9 - Unpaired low surrogate in unicode escape at: 1 5");
+
+		ParseError error;
+		Json legacy("[\"\\ud83d\\ude00\"]", &error);
+		CHECK_EQ(error.get_id(), JSON_OK);
+		CHECK_EQ(legacy[0]->getString(), std::string("\xF0\x9F\x98\x80"));
+	}
+
+	void testInvalidUtf8() {
+		struct Case { const char* doc; const char* error; };
+		const Case cases[] = {
+			{ "[\"\xC3\"]", "at: 1 3" },					// truncated two byte sequence
+			{ "[\"\xE6\x97\"]", "at: 1 3" },				// truncated three byte sequence
+			{ "[\"\xC0\xAF\"]", "at: 1 3" },				// overlong
+			{ "[\"\xE0\x80\x80\"]", "at: 1 3" },			// overlong three byte
+			{ "[\"\xED\xA0\x80\"]", "at: 1 3" },			// encoded surrogate
+			{ "[\"\xF4\x90\x80\x80\"]", "at: 1 3" },		// above U+10FFFF
+			{ "[\"\x80\"]", "at: 1 3" },					// stray continuation byte
+			{ "[\"\xFF\"]", "at: 1 3" },
+			{ "[\"\xC3\xA9\xC3\"]", "at: 1 5" },
+			{ "[\"\xD0\xBF\xD1\x80 abcdefghijklmnopqrstuvwxyz \xC3\xA9\xFF\"]", "at: 1 37" },
+		};
+		for (const Case& test : cases) {
+			ParseResult result = Json::tryParse(test.doc);
+			CHECK_EQ(result.error.info(), std::string("ParseError id: 9 - Invalid UTF-8 sequence in string ") + test.error);
+			checkPushParser(test.doc);
+			ParseError error;
+			Json legacy(test.doc, &error);
+			CHECK_EQ(error.get_id(), JSON_INVALID_STRING);
+		}
+
+		const char* valid = "[\"\xD0\xBF\xD1\x80\xD0\xB8 abcdefghijklmnopqrstuvwxyz \xE6\x97\xA5\xF0\x9F\x98\x80\\n\xC3\xA9\"]";
+		ParseResult result = Json::tryParse(valid);
+		CHECK(result.ok());
+		CHECK_EQ(result.document[0]->getString(), std::string("\xD0\xBF\xD1\x80\xD0\xB8 abcdefghijklmnopqrstuvwxyz \xE6\x97\xA5\xF0\x9F\x98\x80\n\xC3\xA9"));
+		checkPushParser(valid);
+	}
+
+	// Long runs of multi-byte text with a bad sequence or a special byte at every offset, so the error falls
+	// in each position of a 16 byte block and on either side of a block boundary.
+	void testLongMultiByteRuns() {
+		const char* invalid[] = { "\xFF", "\xC3", "\xE6\x97", "\xF0\x9F\x98", "\xED\xA0\x80", "\xC0\xAF", "\xF4\x90\x80\x80", "\x80" };
+		const char* sequences[] = { "\xD0\xBF", "\xE6\x97\xA5", "\xF0\x9F\x98\x80" };
+		for (const char* sequence : sequences) {
+			for (size_t count = 0; count < 24; ++count) {
+				std::string text;
+				for (size_t i = 0; i < count; ++i) text += sequence;
+				std::string column = " " + std::to_string(text.size() + 3);
+
+				ParseResult valid = Json::tryParse("[\"" + text + "\"]");
+				CHECK(valid.ok());
+				CHECK(valid.ok() && valid.document[0]->getString() == text);
+				ParseResult escaped = Json::tryParse("[\"" + text + "\\n" + text + "\"]");
+				CHECK(escaped.ok() && escaped.document[0]->getString() == text + "\n" + text);
+				CHECK_EQ(Json::tryParse("[\"" + text + "\x01\"]").error.info(), "ParseError id: 9 - Unescaped control character in string at: 1" + column);
+
+				for (const char* bad : invalid) {
+					std::string doc = "[\"" + text + bad + sequence + "abc\"]";
+					CHECK_EQ(Json::tryParse(doc).error.info(), "ParseError id: 9 - Invalid UTF-8 sequence in string at: 1" + column);
+					checkPushParser(doc);
+				}
+			}
+		}
+	}
+}
+
+int main() {
+	testSurrogatePairs();
+	testInvalidUtf8();
+	testLongMultiByteRuns();
+	return testResult();
+}